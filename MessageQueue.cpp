@@ -12,36 +12,74 @@ MessageQueue::~MessageQueue()
 
 
 #include <iostream>
-#include <queue>
 #include <functional>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "mpmc_ring_buffer.h"
 
 // Message structure
 struct Message {
     std::string content;
 };
 
-// Message broker
+// Message broker. Any number of producers and consumers may use it at once:
+// messages go through a bounded lock-free ring buffer, so a full broker
+// pushes back on producers instead of growing.
 class MessageBroker {
 private:
-    std::queue<Message> messageQueue;
+    mpmc_ring_buffer::MpmcRingBuffer<Message> messageQueue;
 
 public:
-    // Add message to the queue
-    void addMessage(const Message& message) {
-        messageQueue.push(message);
+    explicit MessageBroker(std::size_t capacity = 1024) : messageQueue(capacity) {}
+
+    // Add message to the queue, waiting for room if it is full. Returns false
+    // if the broker was shut down.
+    bool addMessage(const Message& message) {
+        return messageQueue.enqueue(message);
+    }
+
+    // Add message only if there is room right now and the broker is running
+    bool tryAddMessage(const Message& message) {
+        return messageQueue.tryEnqueue(message);
     }
 
-    // Retrieve next message from the queue
-    Message getNextMessage() {
-        Message message = messageQueue.front();
-        messageQueue.pop();
+    // Add copies of as many of the messages as fit; returns how many were
+    // taken (a prefix of messages; none once the broker is shut down)
+    std::size_t addMessages(const std::vector<Message>& messages) {
+        return messageQueue.enqueueMany(messages.begin(), messages.end());
+    }
+
+    // Retrieve next message from the queue, waiting for one if it is empty;
+    // nothing once the broker is shut down and drained
+    std::optional<Message> getNextMessage() {
+        Message message;
+        if (!messageQueue.dequeue(message)) {
+            return std::nullopt;
+        }
         return message;
     }
 
-    // Check if the queue is empty
+    // Retrieve next message if there is one
+    bool tryGetNextMessage(Message& message) {
+        return messageQueue.tryDequeue(message);
+    }
+
+    // Retrieve up to maxCount messages; returns how many were appended
+    std::size_t getNextMessages(std::vector<Message>& messages, std::size_t maxCount) {
+        return messageQueue.dequeueMany(std::back_inserter(messages), maxCount);
+    }
+
+    // Check if the queue is empty (a snapshot while others are running)
     bool isQueueEmpty() {
         return messageQueue.empty();
     }
+
+    // Wake blocked producers and consumers; nothing more is accepted
+    void shutdown() {
+        messageQueue.close();
+    }
 };
 
 // Producer class
@@ -54,7 +92,10 @@ public:
 
     // Send message to the broker's queue
     void sendMessage(const Message& message) {
-        broker.addMessage(message);
+        if (!broker.addMessage(message)) {
+            std::cerr << "Message not sent, broker is shut down: " << message.content << std::endl;
+            return;
+        }
         std::cout << "Message sent: " << message.content << std::endl;
     }
 };
@@ -71,8 +112,8 @@ public:
 
     // Retrieve message from the broker's queue and process it
     void retrieveMessage() {
-        if (!broker.isQueueEmpty()) {
-            Message message = broker.getNextMessage();
+        Message message;
+        if (broker.tryGetNextMessage(message)) {
             callback(message);
         }
     }
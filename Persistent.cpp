@@ -1,65 +1,179 @@
+#include <algorithm>
+#include <chrono>
 #include <iostream>
 #include <queue>
-#include <fstream>
 #include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <set>
+
+#include "group_commit.h"
+#include "segmented_log.h"
 
 
 namespace Persistent{
 // Message structure
 struct Message {
     std::string content;
+    std::uint64_t offset = 0;  // Position in the broker's log
+};
+
+// How often consumed offsets are checkpointed
+struct OffsetCommitPolicy {
+    std::uint64_t commitEvery = 256;                // acknowledged messages per checkpoint...
+    std::chrono::milliseconds checkpointInterval{1000};  // ...or at least this often while acknowledging
 };
 
 // Message broker
 class MessageBroker {
 private:
-    std::queue<Message> messageQueue;
-    std::string persistenceFilePath;
+    std::mutex queueMutex;
+    std::queue<Message> messageQueue;  // Durable messages not yet handed to a consumer
+
+    // Consumer progress: everything before consumedOffset has been
+    // acknowledged; acknowledgements past a gap wait in acknowledged
+    std::mutex offsetMutex;
+    std::uint64_t consumedOffset = 0;
+    std::set<std::uint64_t> acknowledged;
+    segmented_log::OffsetCheckpoint checkpoint;
+    OffsetCommitPolicy commitPolicy;
+    std::chrono::steady_clock::time_point lastCheckpoint = std::chrono::steady_clock::now();
+
+    // Every message ever added, as one record each, in a directory of
+    // segment files (see segmented_log.h)
+    segmented_log::SegmentedLog log;
+    // Batches appends from all producers into one write + fdatasync
+    // (declared after log, so it is closed first)
+    group_commit::GroupCommitWriter<std::uint64_t> writer;
+
+    // Caller holds offsetMutex
+    void checkpointLocked() {
+        if (checkpoint.offset() != consumedOffset) {
+            checkpoint.commit(consumedOffset);
+        }
+        lastCheckpoint = std::chrono::steady_clock::now();
+    }
 
 public:
-    MessageBroker(const std::string& persistenceFilePath)
-        : persistenceFilePath(persistenceFilePath) {
+    MessageBroker(const std::string& persistenceDirectory,
+                  segmented_log::LogOptions logOptions = segmented_log::LogOptions(),
+                  group_commit::SyncPolicy syncPolicy = group_commit::SyncPolicy(),
+                  OffsetCommitPolicy commitPolicy = OffsetCommitPolicy())
+        : checkpoint(persistenceDirectory + "/consumer.checkpoint"),
+          commitPolicy(commitPolicy),
+          log(persistenceDirectory, logOptions),
+          writer([this](const std::vector<std::string>& records, std::vector<std::uint64_t>& offsets) {
+                     std::uint64_t first = log.appendBatch(records);
+                     for (std::size_t i = 0; i < records.size(); ++i) {
+                         offsets.push_back(first + i);
+                     }
+                 },
+                 [this]() { log.sync(); }, syncPolicy) {
+        if (checkpoint.corrupt()) {
+            std::cerr << "Ignoring unreadable offset checkpoint " << checkpoint.path() << std::endl;
+        }
         // Load persistent messages from disk
         loadPersistentMessages();
     }
 
-    // Add message to the queue and persist it to disk
-    void addMessage(const Message& message) {
-        messageQueue.push(message);
-        persistMessage(message);
+    ~MessageBroker() {
+        try {
+            commitOffsets();
+        } catch (const std::exception& e) {
+            // Progress since the last checkpoint is redelivered after a restart
+            std::cerr << "Cannot checkpoint consumer offset: " << e.what() << std::endl;
+        }
+    }
+
+    // Persist the message and, once it is durable, add it to the queue. The
+    // future completes with the message's log offset at that point.
+    std::future<std::uint64_t> addMessage(const Message& message) {
+        return persistMessage(message);
     }
 
-    // Retrieve next message from the queue
-    Message getNextMessage() {
-        Message message = messageQueue.front();
+    // Retrieve next message if there is one
+    bool tryGetNextMessage(Message& message) {
+        std::lock_guard<std::mutex> lock(queueMutex);
+        if (messageQueue.empty()) {
+            return false;
+        }
+        message = std::move(messageQueue.front());
         messageQueue.pop();
-        return message;
+        return true;
     }
 
-    // Check if the queue is empty
+    // Check if the queue is empty (a snapshot while others are running)
     bool isQueueEmpty() {
+        std::lock_guard<std::mutex> lock(queueMutex);
         return messageQueue.empty();
     }
 
-    // Load persistent messages from disk
-    void loadPersistentMessages() {
-        std::ifstream file(persistenceFilePath);
-        if (file.is_open()) {
-            std::string line;
-            while (std::getline(file, line)) {
-                messageQueue.push({ line });
-            }
-            file.close();
+    // Mark a message as processed. Progress is checkpointed every
+    // commitEvery messages or checkpointInterval, whichever comes first;
+    // messages after the last checkpoint are redelivered after a restart.
+    void acknowledge(const Message& message) {
+        std::lock_guard<std::mutex> lock(offsetMutex);
+        if (message.offset < consumedOffset) {
+            return;
         }
+        acknowledged.insert(message.offset);
+        while (!acknowledged.empty() && *acknowledged.begin() == consumedOffset) {
+            acknowledged.erase(acknowledged.begin());
+            ++consumedOffset;
+        }
+        std::uint64_t committed = checkpoint.offset().value_or(0);
+        if (consumedOffset - committed >= commitPolicy.commitEvery ||
+            std::chrono::steady_clock::now() - lastCheckpoint >= commitPolicy.checkpointInterval) {
+            checkpointLocked();
+        }
+    }
+
+    // Checkpoint consumer progress now
+    void commitOffsets() {
+        std::lock_guard<std::mutex> lock(offsetMutex);
+        checkpointLocked();
+    }
+
+    std::uint64_t committedOffset() {
+        std::lock_guard<std::mutex> lock(offsetMutex);
+        return checkpoint.offset().value_or(log.startOffset());
     }
 
-    // Persist message to disk
-    void persistMessage(const Message& message) {
-        std::ofstream file(persistenceFilePath, std::ios_base::app);
-        if (file.is_open()) {
-            file << message.content << std::endl;
-            file.close();
+    // Load persistent messages from disk: only those after the last
+    // checkpointed offset, straight from the segments that hold them, so
+    // startup work is proportional to the unconsumed backlog rather than to
+    // the whole history
+    void loadPersistentMessages() {
+        std::uint64_t from = std::max(checkpoint.offset().value_or(0), log.startOffset());
+        from = std::min(from, log.nextOffset());
+        {
+            std::lock_guard<std::mutex> lock(offsetMutex);
+            consumedOffset = from;
         }
+        std::lock_guard<std::mutex> lock(queueMutex);
+        log.replay(from, [this](std::uint64_t offset, const char* data, std::uint32_t size) {
+            messageQueue.push({ std::string(data, size), offset });
+        });
+    }
+
+    // Persist message to disk: queued for the writer's next batch, and
+    // delivered (in offset order, from the writer's thread) once synced
+    std::future<std::uint64_t> persistMessage(const Message& message) {
+        auto durable = std::make_shared<std::promise<std::uint64_t>>();
+        std::future<std::uint64_t> result = durable->get_future();
+        writer.append(message.content, [this, durable, message](std::uint64_t offset, std::exception_ptr error) {
+            if (error) {
+                durable->set_exception(error);
+                return;
+            }
+            {
+                std::lock_guard<std::mutex> lock(queueMutex);
+                messageQueue.push({ message.content, offset });
+            }
+            durable->set_value(offset);
+        });
+        return result;
     }
 };
 
@@ -71,10 +185,10 @@ private:
 public:
     Producer(MessageBroker& broker) : broker(broker) {}
 
-    // Send message to the broker's queue
+    // Send message to the broker's queue and wait until it is on disk
     void sendMessage(const Message& message) {
-        broker.addMessage(message);
-        std::cout << "Message sent: " << message.content << std::endl;
+        std::uint64_t offset = broker.addMessage(message).get();
+        std::cout << "Message sent: " << message.content << " (offset " << offset << ")" << std::endl;
     }
 };
 
@@ -90,9 +204,10 @@ public:
 
     // Retrieve message from the broker's queue and process it
     void retrieveMessage() {
-        if (!broker.isQueueEmpty()) {
-            Message message = broker.getNextMessage();
+        Message message;
+        if (broker.tryGetNextMessage(message)) {
             callback(message);
+            broker.acknowledge(message);
         }
     }
 };
@@ -104,8 +219,8 @@ void processMessage(const Message& message) {
 
 int main() {
     // Create a message broker with persistence
-    std::string persistenceFilePath = "messages.txt";
-    MessageBroker broker(persistenceFilePath);
+    std::string persistenceDirectory = "messages";
+    MessageBroker broker(persistenceDirectory);
 
     // Create producers and consumers
     Producer producer1(broker);
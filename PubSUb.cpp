@@ -1,13 +1,20 @@
 
+#include <algorithm>
 #include <atomic>
 #include <chrono>
 #include <condition_variable>
 #include <functional>
 #include <iostream>
+#include <memory>
 #include <mutex>
+#include <sstream>
+#include <string>
 #include <thread>
 #include <unordered_map>
 #include <vector>
+
+#include "mpmc_ring_buffer.h"
+
 namespace pubsub {
 // Define a message structure
 
@@ -20,45 +27,282 @@ struct Message {
 // Define a subscriber function type
 using SubscriberFunc = std::function<void(const Message &)>;
 
+// What happens when a subscriber's queue is full
+enum class OverflowPolicy {
+  Block,       // the partition's dispatcher waits (and publishers behind it)
+  DropNewest,  // the new message is dropped for this subscriber
+  DropOldest,  // the oldest queued message is dropped to make room
+};
+
+struct SubscriberOptions {
+  size_t queueCapacity = 1024;  // rounded up to a power of two
+  OverflowPolicy overflow = OverflowPolicy::Block;
+};
+
+struct BrokerStats {
+  uint64_t published = 0;
+  uint64_t delivered = 0;
+  uint64_t dropped = 0;
+};
+
+// Topics are hashed onto partitions. publish() only enqueues the message on
+// its partition's bounded inbox; each partition has a dispatcher thread that
+// looks the topic up and copies a pointer to the message into the queue of
+// every subscriber to it; each subscriber has its own bounded queue and a
+// thread running its callback. So a slow subscriber only backs up its own
+// queue (and, with OverflowPolicy::Block, its partition), never publishers
+// on other partitions or other subscribers.
+//
+// Messages on a topic reach each subscriber in publish order.
+//
+// The subscription table is read by every dispatch and written only by
+// subscribe(), so it is an immutable snapshot behind an atomic pointer:
+// readers announce themselves on striped epoch counters instead of taking a
+// lock, and subscribe() publishes a modified copy, then waits out the
+// readers of the old one before freeing it (as ReadMostlyCache does in
+// application_caching.cpp).
 class MessageBroker {
 public:
-  MessageBroker(size_t numPartitions) : partitions(numPartitions) {}
-
-  // Publish an event to all interested subscribers
-  void publish(const Message& message) {
-  std::lock_guard<std::mutex> lock(partitionsMutex);
-  size_t partition = hashTopic(message.topic) % partitions.size();
-  
-  if (subscribers.find(partition) != subscribers.end()) {
-    if (subscribers[partition].find(message.topic) != subscribers[partition].end()) {
-      for (const auto& subscriber : subscribers[partition][message.topic]) {
-        subscriber(message);
-      }
+  MessageBroker(size_t numPartitions, size_t partitionCapacity = 4096)
+      : routing(new RoutingTable()), epoch(0) {
+    for (size_t i = 0; i < std::max<size_t>(numPartitions, 1); ++i) {
+      partitions.push_back(std::make_unique<Partition>(partitionCapacity));
+    }
+    for (size_t i = 0; i < partitions.size(); ++i) {
+      partitions[i]->dispatcher = std::thread([this, i]() { dispatch(*partitions[i]); });
     }
   }
-}
 
-  // Subscribe to a topic with a callback function
-  void subscribe(const std::string &topic, const SubscriberFunc &callback) {
-    std::lock_guard<std::mutex> lock(partitionsMutex);
-    size_t partition = hashTopic(topic) % partitions.size();
+  ~MessageBroker() {
+    shutdown();
+    delete routing.load();
+  }
+
+  MessageBroker(const MessageBroker &) = delete;
+  MessageBroker &operator=(const MessageBroker &) = delete;
+
+  // Publish an event to all interested subscribers. Returns once the
+  // message is queued on its partition (blocking only while that inbox is
+  // full); false after shutdown().
+  bool publish(const Message &message) {
+    Partition &partition = *partitions[hashTopic(message.topic) % partitions.size()];
+    // Counted, so shutdown() can wait for publishers that got past the
+    // stopped check before it closes the inboxes.
+    publishers.fetch_add(1, std::memory_order_seq_cst);
+    bool accepted = !stopped.load(std::memory_order_seq_cst) && partition.inbox.enqueue(message);
+    if (accepted) {
+      partition.published.fetch_add(1, std::memory_order_relaxed);
+    }
+    publishers.fetch_sub(1, std::memory_order_release);
+    return accepted;
+  }
+
+  // Subscribe to a topic with a callback function. The callback runs on
+  // the subscriber's own thread, one message at a time.
+  bool subscribe(const std::string &topic, const SubscriberFunc &callback,
+                 SubscriberOptions options = SubscriberOptions()) {
+    std::lock_guard<std::mutex> lock(routingMutex);
+    if (stopped) {
+      return false;
+    }
+
+    auto subscriber = std::make_shared<Subscriber>(callback, options);
+    subscriber->worker = std::thread([this, target = subscriber.get()]() { deliver(*target); });
+    allSubscribers.push_back(subscriber);
+
+    const RoutingTable *old = routing.load(std::memory_order_relaxed);
+    std::unique_ptr<RoutingTable> next(new RoutingTable(*old));
+    auto existing = next->find(topic);
+    auto subscribers = existing == next->end() ? std::make_shared<Subscribers>()
+                                               : std::make_shared<Subscribers>(*existing->second);
+    subscribers->push_back(subscriber);
+    (*next)[topic] = subscribers;
+    routing.store(next.release(), std::memory_order_seq_cst);
 
-    size_t part = hashTopic(topic) % partitions.size();
+    waitForReaders();
+    waitForReaders();
+    delete old;
+    return true;
+  }
+
+  // Stops accepting messages, delivers everything already published, then
+  // stops every thread. Called by the destructor.
+  void shutdown() {
+    {
+      std::lock_guard<std::mutex> lock(routingMutex);
+      if (stopped) {
+        return;
+      }
+      stopped.store(true, std::memory_order_seq_cst);
+    }
+    // Publishers still inside publish() finish enqueueing (the dispatchers
+    // are still draining); later ones see stopped.
+    while (publishers.load(std::memory_order_seq_cst) != 0) {
+      std::this_thread::yield();
+    }
+    for (auto &partition : partitions) {
+      partition->inbox.close();
+    }
+    for (auto &partition : partitions) {
+      partition->dispatcher.join();
+    }
+    for (auto &subscriber : allSubscribers) {
+      subscriber->queue.close();
+    }
+    for (auto &subscriber : allSubscribers) {
+      subscriber->worker.join();
+    }
+  }
 
-    subscribers[part][topic].push_back(callback);
+  BrokerStats stats() {
+    BrokerStats stats;
+    for (auto &partition : partitions) {
+      stats.published += partition->published.load(std::memory_order_relaxed);
+    }
+    std::lock_guard<std::mutex> lock(routingMutex);
+    for (auto &subscriber : allSubscribers) {
+      stats.delivered += subscriber->delivered.load(std::memory_order_relaxed);
+      stats.dropped += subscriber->dropped.load(std::memory_order_relaxed);
+    }
+    return stats;
   }
 
 private:
-  std::unordered_map<
-      size_t, std::unordered_map<std::string, std::vector<SubscriberFunc>>>
-      subscribers;
-  std::unordered_map<std::string, size_t> partitions;
-  std::mutex partitionsMutex;
+  using SharedMessage = std::shared_ptr<const Message>;
+
+  struct Subscriber {
+    Subscriber(const SubscriberFunc &callback, SubscriberOptions options)
+        : callback(callback), overflow(options.overflow), queue(options.queueCapacity) {}
+
+    SubscriberFunc callback;
+    OverflowPolicy overflow;
+    mpmc_ring_buffer::MpmcRingBuffer<SharedMessage> queue;
+    std::atomic<uint64_t> delivered{0};
+    std::atomic<uint64_t> dropped{0};
+    std::thread worker;
+  };
+
+  struct Partition {
+    explicit Partition(size_t capacity) : inbox(capacity) {}
+
+    mpmc_ring_buffer::MpmcRingBuffer<Message> inbox;
+    std::atomic<uint64_t> published{0};
+    std::thread dispatcher;
+  };
+
+  // A topic's subscriber list is itself immutable and shared between
+  // snapshots, so a dispatcher can hold on to it after leaving the table.
+  using Subscribers = std::vector<std::shared_ptr<Subscriber>>;
+  using RoutingTable = std::unordered_map<std::string, std::shared_ptr<const Subscribers>>;
+
+  static constexpr size_t kReaderStripes = 16;
+
+  struct alignas(64) ReaderCount {
+    std::atomic<size_t> active{0};
+  };
+
+  class ReadGuard {
+  public:
+    explicit ReadGuard(MessageBroker &broker)
+        : counter(broker.readers[broker.epoch.load(std::memory_order_seq_cst)][stripe()].active) {
+      counter.fetch_add(1, std::memory_order_seq_cst);
+    }
+    ~ReadGuard() {
+      counter.fetch_sub(1, std::memory_order_release);
+    }
+
+  private:
+    static size_t stripe() {
+      static thread_local size_t index = std::hash<std::thread::id>{}(std::this_thread::get_id()) % kReaderStripes;
+      return index;
+    }
+
+    std::atomic<size_t> &counter;
+  };
+
+  std::shared_ptr<const Subscribers> lookup(const std::string &topic) {
+    ReadGuard guard(*this);
+    const RoutingTable *table = routing.load(std::memory_order_seq_cst);
+    auto it = table->find(topic);
+    return it == table->end() ? nullptr : it->second;
+  }
+
+  // Caller holds routingMutex. Flips the epoch so new readers use the other
+  // counter, then waits for everyone on the previous one to leave.
+  void waitForReaders() {
+    size_t previous = epoch.load(std::memory_order_relaxed);
+    epoch.store(previous ^ 1, std::memory_order_seq_cst);
+    for (ReaderCount &count : readers[previous]) {
+      while (count.active.load(std::memory_order_acquire) != 0) {
+        std::this_thread::yield();
+      }
+    }
+  }
+
+  // A partition's dispatcher: fans each message out to the topic's
+  // subscribers until the inbox is closed and drained.
+  void dispatch(Partition &partition) {
+    Message message;
+    while (partition.inbox.dequeue(message)) {
+      std::shared_ptr<const Subscribers> subscribers = lookup(message.topic);
+      if (!subscribers) {
+        continue;
+      }
+      SharedMessage shared = std::make_shared<const Message>(std::move(message));
+      for (const auto &subscriber : *subscribers) {
+        enqueue(*subscriber, shared);
+      }
+    }
+  }
+
+  void enqueue(Subscriber &subscriber, const SharedMessage &message) {
+    switch (subscriber.overflow) {
+    case OverflowPolicy::Block:
+      subscriber.queue.enqueue(message);
+      break;
+    case OverflowPolicy::DropNewest:
+      if (!subscriber.queue.tryEnqueue(message)) {
+        subscriber.dropped.fetch_add(1, std::memory_order_relaxed);
+      }
+      break;
+    case OverflowPolicy::DropOldest:
+      while (!subscriber.queue.tryEnqueue(message)) {
+        SharedMessage oldest;
+        if (subscriber.queue.tryDequeue(oldest)) {
+          subscriber.dropped.fetch_add(1, std::memory_order_relaxed);
+        }
+      }
+      break;
+    }
+  }
+
+  // A subscriber's thread: runs the callback on each queued message.
+  void deliver(Subscriber &subscriber) {
+    SharedMessage message;
+    while (subscriber.queue.dequeue(message)) {
+      try {
+        subscriber.callback(*message);
+      } catch (const std::exception &e) {
+        std::cerr << "Subscriber failed on topic " << message->topic << ": " << e.what() << std::endl;
+      }
+      subscriber.delivered.fetch_add(1, std::memory_order_relaxed);
+      message.reset();
+    }
+  }
 
   size_t hashTopic(const std::string &topic) {
     std::hash<std::string> hasher;
     return hasher(topic);
   }
+
+  std::vector<std::unique_ptr<Partition>> partitions;
+  std::atomic<const RoutingTable *> routing;
+  std::atomic<size_t> epoch;
+  ReaderCount readers[2][kReaderStripes];
+  std::mutex routingMutex;  // serialises subscribe() and shutdown()
+  std::vector<std::shared_ptr<Subscriber>> allSubscribers;
+  std::atomic<bool> stopped{false};
+  std::atomic<size_t> publishers{0};  // threads inside publish()
 };
 
 // Example usage
@@ -68,16 +312,26 @@ int main() {
 
   // Subscriber 1
   broker.subscribe("topic1", [](const Message &message) {
-    std::cout << "Subscriber 1 received message: " << message.content
-              << std::endl;
+    std::ostringstream line;
+    line << "Subscriber 1 received message: " << message.content << std::endl;
+    std::cout << line.str();
   });
 
   // Subscriber 2
   broker.subscribe("topic2", [](const Message &message) {
-    std::cout << "Subscriber 2 received message: " << message.content
-              << std::endl;
+    std::ostringstream line;
+    line << "Subscriber 2 received message: " << message.content << std::endl;
+    std::cout << line.str();
   });
 
+  // Subscriber 3: slow, and only wants the latest few messages
+  broker.subscribe("topic1", [](const Message &message) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    std::ostringstream line;
+    line << "Subscriber 3 (slow) received message: " << message.content << std::endl;
+    std::cout << line.str();
+  }, SubscriberOptions{4, OverflowPolicy::DropOldest});
+
   // Publish messages
   Message message1{"topic1", "Hello, subscribers!"};
   broker.publish(message1);
@@ -85,7 +339,18 @@ int main() {
   Message message2{"topic2", "Greetings, everyone!"};
   broker.publish(message2);
 
+  // The slow subscriber doesn't hold these up; it sees only the last few
+  for (int i = 0; i < 10; ++i) {
+    broker.publish({"topic1", "update " + std::to_string(i)});
+  }
+
+  // Deliver whatever is still queued
+  broker.shutdown();
+  BrokerStats stats = broker.stats();
+  std::cout << "published " << stats.published << ", delivered " << stats.delivered << ", dropped "
+            << stats.dropped << std::endl;
+
   return 0;
 }
 
-} // namespace pubsub
\ No newline at end of file
+} // namespace pubsub
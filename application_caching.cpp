@@ -7,83 +7,1222 @@
 #include <future>
 #include <atomic>
 #include <stdexcept>
+#include <memory>
+#include <vector>
+#include <list>
+#include <string>
+#include <limits>
+#include <deque>
+#include <condition_variable>
+#include <cmath>
+#include <cstdint>
 
+#include "mmap_cache_tier.h"
+#include "timing_wheel.h"
+
+// Approximate heap footprint of a cached value. Specialise (or pass a custom
+// Sizer to Cache) for types that own memory beyond these.
+template <typename T>
+struct ByteSize {
+    std::size_t operator()(const T&) const { return sizeof(T); }
+};
+
+template <typename Char, typename Traits, typename Alloc>
+struct ByteSize<std::basic_string<Char, Traits, Alloc>> {
+    std::size_t operator()(const std::basic_string<Char, Traits, Alloc>& value) const {
+        return sizeof(value) + value.capacity() * sizeof(Char);
+    }
+};
+
+template <typename T, typename Alloc>
+struct ByteSize<std::vector<T, Alloc>> {
+    std::size_t operator()(const std::vector<T, Alloc>& value) const {
+        std::size_t bytes = sizeof(value) + (value.capacity() - value.size()) * sizeof(T);
+        for (const T& element : value) {
+            bytes += ByteSize<T>{}(element);
+        }
+        return bytes;
+    }
+};
+
+// Default Sizer: key plus value plus a rough per-entry bookkeeping overhead
+// (hash node, recency list node, expiry).
 template <typename Key, typename Value>
+struct DefaultCacheSizer {
+    std::size_t operator()(const Key& key, const Value& value) const {
+        return ByteSize<Key>{}(key) * 2 + ByteSize<Value>{}(value) + 64;
+    }
+};
+
+struct CacheStats {
+    std::size_t residentBytes;
+    std::size_t evictedBytes;
+    std::size_t evictedEntries;
+    std::size_t shedFetches;      // misses turned away because the fetch executor was full
+    std::size_t breakerRejections; // misses turned away by an open circuit breaker
+    std::size_t negativeHits;     // lookups answered "absent" from the negative cache
+    std::size_t filteredKeys;     // lookups the existence filter ruled out without a fetch
+};
+
+// Thrown by a fetch function when the key does not exist downstream. Cache
+// remembers it (negative caching) and rethrows it from get(); getMany()
+// simply leaves such keys out of its result.
+class KeyNotFound : public std::runtime_error {
+public:
+    KeyNotFound() : std::runtime_error("Key not found.") {}
+};
+
+// Bloom filter over the keys that exist downstream: mightContain() false
+// means the key is definitely absent, true means "probably present". Adds
+// and lookups are lock-free and may run concurrently.
+template <typename Key>
+class BloomFilter {
+public:
+    BloomFilter(std::size_t expectedKeys, double falsePositiveRate = 0.01) {
+        expectedKeys = std::max<std::size_t>(expectedKeys, 1);
+        falsePositiveRate = std::min(std::max(falsePositiveRate, 1e-9), 0.5);
+        // m = -n ln p / (ln 2)^2 bits, k = m / n ln 2 hashes.
+        double bits = -static_cast<double>(expectedKeys) * std::log(falsePositiveRate) / (std::log(2.0) * std::log(2.0));
+        words_ = std::vector<std::atomic<std::uint64_t>>((static_cast<std::size_t>(bits) + 63) / 64 + 1);
+        hashes_ = std::max<std::size_t>(1, static_cast<std::size_t>(bits / expectedKeys * std::log(2.0) + 0.5));
+    }
+
+    void add(const Key& key) {
+        forEachBit(key, [this](std::size_t bit) {
+            words_[bit / 64].fetch_or(std::uint64_t(1) << (bit % 64), std::memory_order_relaxed);
+        });
+    }
+
+    bool mightContain(const Key& key) const {
+        bool all = true;
+        forEachBit(key, [this, &all](std::size_t bit) {
+            all = all && (words_[bit / 64].load(std::memory_order_relaxed) & (std::uint64_t(1) << (bit % 64))) != 0;
+        });
+        return all;
+    }
+
+private:
+    // Double hashing (Kirsch-Mitzenmacher): bit i = h1 + i * h2.
+    template <typename Visit>
+    void forEachBit(const Key& key, Visit&& visit) const {
+        std::uint64_t h1 = std::hash<Key>{}(key) * 0x9E3779B97F4A7C15ULL;
+        std::uint64_t h2 = (h1 >> 32 | h1 << 32) | 1;
+        std::size_t bits = words_.size() * 64;
+        for (std::size_t i = 0; i < hashes_; ++i) {
+            visit(static_cast<std::size_t>((h1 + i * h2) % bits));
+        }
+    }
+
+    std::vector<std::atomic<std::uint64_t>> words_;
+    std::size_t hashes_;
+};
+
+// How misses reach the downstream.
+struct FetchPolicy {
+    std::size_t maxConcurrentFetches = 8;  // fetch executor threads
+    std::size_t maxQueuedFetches = 256;    // beyond this, misses are shed
+    std::chrono::milliseconds fetchTimeout{1000};
+    std::size_t failureThreshold = 5;      // consecutive failures that open the breaker
+    std::chrono::milliseconds openDuration{5000}; // how long it stays open before probing
+    std::size_t halfOpenProbes = 1;        // concurrent trial fetches while half-open
+};
+
+// Fixed set of threads running fetches, with a bounded queue in front. When
+// the queue is full trySubmit refuses the work instead of growing.
+class FetchExecutor {
+public:
+    FetchExecutor(std::size_t threads, std::size_t maxQueued) : maxQueued_(maxQueued) {
+        for (std::size_t i = 0; i < std::max<std::size_t>(threads, 1); ++i) {
+            workers_.emplace_back([this]() { run(); });
+        }
+    }
+
+    ~FetchExecutor() {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stopping_ = true;
+        }
+        ready_.notify_all();
+        for (std::thread& worker : workers_) {
+            worker.join();
+        }
+    }
+
+    bool trySubmit(std::function<void()> task) {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (queue_.size() >= maxQueued_) {
+                return false;
+            }
+            queue_.push_back(std::move(task));
+        }
+        ready_.notify_one();
+        return true;
+    }
+
+private:
+    void run() {
+        std::unique_lock<std::mutex> lock(mutex_);
+        while (true) {
+            ready_.wait(lock, [this]() { return stopping_ || !queue_.empty(); });
+            if (stopping_) {
+                return; // queued fetches are dropped; their waiters see a broken promise
+            }
+            std::function<void()> task = std::move(queue_.front());
+            queue_.pop_front();
+            lock.unlock();
+            task();
+            lock.lock();
+        }
+    }
+
+    std::size_t maxQueued_;
+    std::mutex mutex_;
+    std::condition_variable ready_;
+    std::deque<std::function<void()>> queue_;
+    bool stopping_ = false;
+    std::vector<std::thread> workers_;
+};
+
+// Closed: every miss may fetch; failureThreshold consecutive failures open
+// it. Open: misses are rejected until openDuration has passed, then it goes
+// half-open. Half-open: up to halfOpenProbes trial fetches are let through;
+// a success closes it, a failure opens it again for another openDuration.
+class CircuitBreaker {
+public:
+    enum class State { Closed, Open, HalfOpen };
+
+    CircuitBreaker(std::size_t failureThreshold, std::chrono::milliseconds openDuration, std::size_t halfOpenProbes)
+        : failureThreshold_(std::max<std::size_t>(failureThreshold, 1)), openDuration_(openDuration),
+          halfOpenProbes_(std::max<std::size_t>(halfOpenProbes, 1)) {}
+
+    // True if a new fetch may start. In half-open state the caller holds one
+    // of the probe slots and must report back (or call abandon()).
+    bool allowRequest() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (state_ == State::Open) {
+            if (std::chrono::steady_clock::now() < openUntil_) {
+                return false;
+            }
+            state_ = State::HalfOpen;
+            probesInFlight_ = 0;
+        }
+        if (state_ == State::HalfOpen) {
+            if (probesInFlight_ >= halfOpenProbes_) {
+                return false;
+            }
+            ++probesInFlight_;
+        }
+        return true;
+    }
+
+    void onSuccess() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        consecutiveFailures_ = 0;
+        if (state_ == State::HalfOpen) {
+            std::cerr << "Circuit breaker closed" << std::endl;
+            state_ = State::Closed;
+        }
+    }
+
+    void onFailure() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (state_ == State::HalfOpen || ++consecutiveFailures_ >= failureThreshold_) {
+            if (state_ != State::Open) {
+                std::cerr << "Circuit breaker opened" << std::endl;
+            }
+            state_ = State::Open;
+            openUntil_ = std::chrono::steady_clock::now() + openDuration_;
+            consecutiveFailures_ = 0;
+        }
+    }
+
+    // An admitted request that never reached the downstream.
+    void abandon() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (state_ == State::HalfOpen && probesInFlight_ > 0) {
+            --probesInFlight_;
+        }
+    }
+
+    State state() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return state_;
+    }
+
+private:
+    std::mutex mutex_;
+    State state_ = State::Closed;
+    std::size_t consecutiveFailures_ = 0;
+    std::size_t probesInFlight_ = 0;
+    std::chrono::steady_clock::time_point openUntil_;
+    std::size_t failureThreshold_;
+    std::chrono::milliseconds openDuration_;
+    std::size_t halfOpenProbes_;
+};
+
+// The key space is split across independent shards, each with its own lock
+// and map, so a hit only contends with traffic on the same shard. Fetches for
+// misses run without holding any shard lock, and concurrent misses on the
+// same key share a single fetch (single-flight).
+//
+// Memory is bounded both by entry count (maxCacheSize) and by bytes
+// (maxCacheBytes, measured with Sizer). When a shard goes over either limit it
+// first drops expired entries, then evicts least recently used ones until it
+// is back within budget.
+//
+// Expired entries are tracked in a per-shard timing wheel, and every get()
+// retires a few of them, so expiry never needs a scan of the whole shard.
+//
+// An optional second tier (a memory-mapped file, see mmap_cache_tier.h) sits
+// between the shards and fetchFunc: misses check it first, and fetched values
+// are written through to it, so a restarted process starts warm.
+//
+// Fetches run on a bounded FetchExecutor behind a CircuitBreaker (see
+// FetchPolicy). A miss that the breaker or a full executor turns away gets a
+// default-constructed Value, as the original open-breaker path did.
+//
+// getMany() looks up a batch of keys taking each shard lock once, and fetches
+// all the misses in one fetchMany call. Keys the downstream reports missing
+// (KeyNotFound, or left out of a fetchMany result) are remembered for
+// negativeTtl, and an optional Bloom filter of existing keys answers
+// "absent" for the rest without touching the cache at all.
+template <typename Key, typename Value, typename Sizer = DefaultCacheSizer<Key, Value>>
 class Cache {
 public:
     using TimePoint = std::chrono::time_point<std::chrono::steady_clock>;
+    // Returns the values of the keys that exist; keys left out are absent.
+    using FetchManyFunc = std::function<std::unordered_map<Key, Value>(const std::vector<Key>&)>;
 
-    Cache(std::chrono::seconds expiryTime, std::function<Value(const Key&)> fetchFunc, std::size_t maxCacheSize)
-        : expiryTime_(expiryTime), fetchFunc_(fetchFunc), maxCacheSize_(maxCacheSize), circuitBreakerOpen_(false)
+    Cache(std::chrono::seconds expiryTime, std::function<Value(const Key&)> fetchFunc, std::size_t maxCacheSize,
+          std::size_t shardCount = 16, std::size_t maxCacheBytes = std::numeric_limits<std::size_t>::max(),
+          Sizer sizer = Sizer())
+        : expiryTime_(expiryTime), fetchFunc_(fetchFunc), sizer_(sizer), negativeTtl_(0), residentBytes_(0),
+          evictedBytes_(0), evictedEntries_(0), shedFetches_(0), breakerRejections_(0), negativeHits_(0),
+          filteredKeys_(0)
     {
+        setFetchPolicy(FetchPolicy());
+        if (shardCount == 0) {
+            shardCount = 1;
+        }
+        // Both limits are whole-cache limits; each shard gets its share.
+        maxShardSize_ = (maxCacheSize + shardCount - 1) / shardCount;
+        maxShardBytes_ = maxCacheBytes / shardCount;
+        for (std::size_t i = 0; i < shardCount; ++i) {
+            shards_.push_back(std::make_unique<Shard>(std::chrono::steady_clock::now()));
+        }
     }
 
     Value get(const Key& key) {
-        std::lock_guard<std::mutex> lock(mutex_);
+        if (ruledOut(key)) {
+            throw KeyNotFound();
+        }
 
-        auto it = cache_.find(key);
-        if (it != cache_.end() && std::chrono::steady_clock::now() < it->second.first) {
-            return it->second.second;
+        Shard& shard = shardFor(key);
+        std::shared_future<Value> pending;
+        std::shared_ptr<std::atomic<bool>> reported;
+        bool leader = false;
+        {
+            std::lock_guard<std::mutex> lock(shard.mutex);
+            TimePoint now = std::chrono::steady_clock::now();
+            expire(shard, now, kExpiryStepBudget);
+            auto it = shard.entries.find(key);
+            if (it != shard.entries.end() && now < it->second.expiresAt) {
+                shard.recency.splice(shard.recency.begin(), shard.recency, it->second.recency);
+                return it->second.value;
+            }
+            if (knownAbsent(shard, key, now)) {
+                throw KeyNotFound();
+            }
+
+            auto inFlight = shard.inFlight.find(key);
+            if (inFlight != shard.inFlight.end()) {
+                pending = inFlight->second;
+            }
         }
 
-        if (!circuitBreakerOpen_.load(std::memory_order_acquire)) {
-            try {
-                std::future<Value> future = std::async(std::launch::async, fetchFunc_, key);
-                std::future_status status = future.wait_for(std::chrono::seconds(1));
+        // A second-tier hit needs neither the downstream nor the breaker that
+        // guards it. Probed without the shard lock held.
+        if (!pending.valid()) {
+            TimePoint expiresAt;
+            if (std::optional<Value> stored = fromSecondTier(key, expiresAt)) {
+                std::lock_guard<std::mutex> lock(shard.mutex);
+                insert(shard, key, *stored, expiresAt);
+                return *stored;
+            }
+
+            // Join the fetch another caller already started for this key, or
+            // become the one caller that starts it.
+            std::lock_guard<std::mutex> lock(shard.mutex);
+            auto inFlight = shard.inFlight.find(key);
+            if (inFlight != shard.inFlight.end()) {
+                pending = inFlight->second;
+            }
+            else {
+                if (!breaker_->allowRequest()) {
+                    breakerRejections_.fetch_add(1, std::memory_order_relaxed);
+                    return Value(); // Circuit breaker is open: don't hit the downstream
+                }
+                std::optional<FetchHandle> started = startFetch(key);
+                if (!started) {
+                    breaker_->abandon();
+                    shedFetches_.fetch_add(1, std::memory_order_relaxed);
+                    return Value(); // Fetch executor saturated: shed the miss
+                }
+                pending = started->result;
+                reported = started->reported;
+                shard.inFlight.emplace(key, pending);
+                leader = true;
+            }
+        }
+
+        try {
+            std::future_status status = pending.wait_for(fetchPolicy_.fetchTimeout);
+
+            if (status == std::future_status::ready) {
+                Value value = pending.get();
+                if (leader) {
+                    std::lock_guard<std::mutex> lock(shard.mutex);
+                    insert(shard, key, value);
+                    shard.inFlight.erase(key);
+                }
+                return value;
+            }
+            else {
+                if (leader && !reported->exchange(true)) {
+                    breaker_->onFailure();
+                }
+                throw std::runtime_error("Fetch function timed out.");
+            }
+        }
+        catch (const KeyNotFound&) {
+            if (leader) {
+                std::lock_guard<std::mutex> lock(shard.mutex);
+                insertAbsent(shard, key);
+                shard.inFlight.erase(key);
+            }
+            throw;
+        }
+        catch (const std::exception& e) {
+            // Handle fetch function exception. The breaker has already been
+            // told, by the fetch itself or by the timeout above.
+            std::cerr << "Fetch function error: " << e.what() << std::endl;
+            if (leader) {
+                std::lock_guard<std::mutex> lock(shard.mutex);
+                shard.inFlight.erase(key);
+            }
+            throw;
+        }
+
+        return Value(); // Return default value if fetch function failed or circuit breaker is open
+    }
+
+    // Looks up many keys at once: each shard's lock is taken once for all of
+    // its keys, and every miss goes downstream in a single batched fetch
+    // (fetchMany if set, otherwise fetchFunc per key on one executor slot).
+    // The result holds the keys that were found; keys that are absent, or
+    // whose fetch was rejected, failed or timed out, are left out.
+    std::unordered_map<Key, Value> getMany(const std::vector<Key>& keys) {
+        struct Pending {
+            Key key;
+            std::shared_future<Value> result;
+        };
 
-                if (status == std::future_status::ready) {
-                    Value value = future.get();
-                    cache_[key] = std::make_pair(std::chrono::steady_clock::now() + expiryTime_, value);
-                    cleanupCache();
-                    return value;
+        std::unordered_map<Key, Value> found;
+        std::vector<std::vector<Key>> byShard(shards_.size());
+        for (const Key& key : keys) {
+            if (!ruledOut(key)) {
+                byShard[std::hash<Key>{}(key) % shards_.size()].push_back(key);
+            }
+        }
+
+        std::vector<Pending> joined;
+        std::vector<std::vector<Pending>> led(shards_.size());
+        std::vector<Key> toFetch;
+        std::vector<std::shared_ptr<std::promise<Value>>> promises;
+        for (std::size_t index = 0; index < shards_.size(); ++index) {
+            if (byShard[index].empty()) {
+                continue;
+            }
+            Shard& shard = *shards_[index];
+            std::lock_guard<std::mutex> lock(shard.mutex);
+            TimePoint now = std::chrono::steady_clock::now();
+            expire(shard, now, kExpiryStepBudget);
+            for (const Key& key : byShard[index]) {
+                auto it = shard.entries.find(key);
+                if (it != shard.entries.end() && now < it->second.expiresAt) {
+                    shard.recency.splice(shard.recency.begin(), shard.recency, it->second.recency);
+                    found.emplace(key, it->second.value);
+                    continue;
                 }
-                else if (status == std::future_status::timeout) {
-                    circuitBreakerOpen_.store(true, std::memory_order_release);
-                    throw std::runtime_error("Fetch function timed out.");
+                if (knownAbsent(shard, key, now) || found.count(key)) {
+                    continue;
                 }
+                auto inFlight = shard.inFlight.find(key);
+                if (inFlight != shard.inFlight.end()) {
+                    joined.push_back({key, inFlight->second});
+                    continue;
+                }
+                auto promise = std::make_shared<std::promise<Value>>();
+                std::shared_future<Value> result = promise->get_future().share();
+                shard.inFlight.emplace(key, result);
+                led[index].push_back({key, result});
+                toFetch.push_back(key);
+                promises.push_back(std::move(promise));
+            }
+        }
+
+        // Second-tier hits skip the breaker and the executor, and keep the
+        // deadline they were stored with.
+        std::unordered_map<Key, TimePoint> storedExpiry;
+        if (secondTier_ && !toFetch.empty()) {
+            std::vector<Key> remaining;
+            std::vector<std::shared_ptr<std::promise<Value>>> remainingPromises;
+            for (std::size_t i = 0; i < toFetch.size(); ++i) {
+                TimePoint expiresAt;
+                if (std::optional<Value> stored = fromSecondTier(toFetch[i], expiresAt)) {
+                    promises[i]->set_value(std::move(*stored));
+                    storedExpiry.emplace(toFetch[i], expiresAt);
+                }
+                else {
+                    remaining.push_back(toFetch[i]);
+                    remainingPromises.push_back(promises[i]);
+                }
+            }
+            toFetch.swap(remaining);
+            promises.swap(remainingPromises);
+        }
+
+        auto reported = std::make_shared<std::atomic<bool>>(false);
+        if (!toFetch.empty()) {
+            bool started = false;
+            if (!breaker_->allowRequest()) {
+                breakerRejections_.fetch_add(toFetch.size(), std::memory_order_relaxed);
+            }
+            else if (!(started = startBatchFetch(toFetch, promises, reported))) {
+                breaker_->abandon();
+                shedFetches_.fetch_add(toFetch.size(), std::memory_order_relaxed);
+            }
+            if (!started) {
+                // Nobody will fulfil these: fail them so joined callers don't hang.
+                for (auto& promise : promises) {
+                    promise->set_exception(std::make_exception_ptr(std::runtime_error("Fetch rejected.")));
+                }
+            }
+        }
+
+        TimePoint deadline = std::chrono::steady_clock::now() + fetchPolicy_.fetchTimeout;
+        bool timedOut = false;
+        auto collect = [&](const Pending& pending) {
+            if (pending.result.wait_until(deadline) != std::future_status::ready) {
+                timedOut = true;
+                return;
+            }
+            try {
+                found.emplace(pending.key, pending.result.get());
+            }
+            catch (const KeyNotFound&) {
             }
             catch (const std::exception& e) {
-                // Handle fetch function exception
                 std::cerr << "Fetch function error: " << e.what() << std::endl;
-                circuitBreakerOpen_.store(true, std::memory_order_release);
-                throw;
+            }
+        };
+        for (const Pending& pending : joined) {
+            collect(pending);
+        }
+        for (std::size_t index = 0; index < shards_.size(); ++index) {
+            for (const Pending& pending : led[index]) {
+                collect(pending);
             }
         }
+        if (timedOut && !toFetch.empty() && !reported->exchange(true)) {
+            breaker_->onFailure();
+        }
 
-        return Value(); // Return default value if fetch function failed or circuit breaker is open
+        // Store what this call fetched, again one lock per shard.
+        for (std::size_t index = 0; index < shards_.size(); ++index) {
+            if (led[index].empty()) {
+                continue;
+            }
+            Shard& shard = *shards_[index];
+            std::lock_guard<std::mutex> lock(shard.mutex);
+            for (const Pending& pending : led[index]) {
+                if (pending.result.wait_for(std::chrono::seconds(0)) == std::future_status::ready) {
+                    try {
+                        auto kept = storedExpiry.find(pending.key);
+                        if (kept != storedExpiry.end()) {
+                            insert(shard, pending.key, pending.result.get(), kept->second);
+                        }
+                        else {
+                            insert(shard, pending.key, pending.result.get());
+                        }
+                    }
+                    catch (const KeyNotFound&) {
+                        insertAbsent(shard, pending.key);
+                    }
+                    catch (const std::exception&) {
+                    }
+                }
+                shard.inFlight.erase(pending.key);
+            }
+        }
+        return found;
+    }
+
+    // Call before the cache is shared between threads.
+    void setFetchMany(FetchManyFunc fetchMany) {
+        fetchMany_ = std::move(fetchMany);
+    }
+
+    // How long "absent" answers are remembered; zero (the default) turns
+    // negative caching off. Call before the cache is shared between threads.
+    void setNegativeTtl(std::chrono::milliseconds ttl) {
+        negativeTtl_ = ttl;
+    }
+
+    // Bloom filter of every key that exists downstream; keys it rules out
+    // are answered "absent" without a lookup or fetch. The owner keeps it up
+    // to date with add(). Call before the cache is shared between threads.
+    void setExistenceFilter(std::shared_ptr<BloomFilter<Key>> filter) {
+        existenceFilter_ = std::move(filter);
+    }
+
+    // Call before the cache is shared between threads.
+    void setFetchPolicy(const FetchPolicy& policy) {
+        fetchExecutor_.reset();
+        fetchPolicy_ = policy;
+        breaker_ = std::make_shared<CircuitBreaker>(policy.failureThreshold, policy.openDuration, policy.halfOpenProbes);
+        fetchExecutor_ = std::make_unique<FetchExecutor>(policy.maxConcurrentFetches, policy.maxQueuedFetches);
+    }
+
+    CircuitBreaker::State breakerState() {
+        return breaker_->state();
+    }
+
+    // Call before the cache is shared between threads.
+    void setSecondTier(std::shared_ptr<mmap_cache_tier::L2Tier<Key, Value>> secondTier) {
+        secondTier_ = std::move(secondTier);
     }
 
     void remove(const Key& key) {
-        std::lock_guard<std::mutex> lock(mutex_);
-        cache_.erase(key);
+        if (secondTier_) {
+            secondTier_->remove(key);
+        }
+        Shard& shard = shardFor(key);
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        auto it = shard.entries.find(key);
+        if (it != shard.entries.end()) {
+            erase(shard, it);
+        }
+        if (shard.absent.erase(key) != 0) {
+            shard.expiry.cancel(key);
+        }
+    }
+
+    std::size_t shardCount() const {
+        return shards_.size();
+    }
+
+    CacheStats stats() const {
+        return {residentBytes_.load(std::memory_order_relaxed), evictedBytes_.load(std::memory_order_relaxed),
+                evictedEntries_.load(std::memory_order_relaxed), shedFetches_.load(std::memory_order_relaxed),
+                breakerRejections_.load(std::memory_order_relaxed), negativeHits_.load(std::memory_order_relaxed),
+                filteredKeys_.load(std::memory_order_relaxed)};
     }
 
 private:
-    std::unordered_map<Key, std::pair<TimePoint, Value>> cache_;
+    struct Entry {
+        TimePoint expiresAt;
+        Value value;
+        std::size_t bytes;
+        typename std::list<Key>::iterator recency;
+    };
+
+    // Wheel granularity and how many expired entries one get() retires.
+    static constexpr std::chrono::milliseconds kExpiryTick{100};
+    static constexpr std::size_t kExpiryStepBudget = 4;
+
+    struct Shard {
+        explicit Shard(TimePoint origin) : expiry(kExpiryTick, origin) {}
+
+        std::mutex mutex;
+        std::unordered_map<Key, Entry> entries;
+        std::list<Key> recency; // most recently used first
+        std::size_t bytes = 0;
+        // Keys known not to exist downstream, until the given time. They
+        // share the expiry wheel with entries (a key is in one or the other).
+        std::unordered_map<Key, TimePoint> absent;
+        timing_wheel::TimingWheel<Key> expiry;
+        // Fetches currently running, so later misses wait on them instead of
+        // issuing their own.
+        std::unordered_map<Key, std::shared_future<Value>> inFlight;
+    };
+
+    std::vector<std::unique_ptr<Shard>> shards_;
     std::chrono::seconds expiryTime_;
     std::function<Value(const Key&)> fetchFunc_;
-    std::size_t maxCacheSize_;
-    std::atomic<bool> circuitBreakerOpen_;
-    std::mutex mutex_;
+    Sizer sizer_;
+    FetchManyFunc fetchMany_;
+    std::chrono::milliseconds negativeTtl_;
+    std::shared_ptr<BloomFilter<Key>> existenceFilter_;
+    std::size_t maxShardSize_;
+    std::size_t maxShardBytes_;
+    std::atomic<std::size_t> residentBytes_;
+    std::atomic<std::size_t> evictedBytes_;
+    std::atomic<std::size_t> evictedEntries_;
+    std::atomic<std::size_t> shedFetches_;
+    std::atomic<std::size_t> breakerRejections_;
+    std::atomic<std::size_t> negativeHits_;
+    std::atomic<std::size_t> filteredKeys_;
+    std::shared_ptr<mmap_cache_tier::L2Tier<Key, Value>> secondTier_;
+    FetchPolicy fetchPolicy_;
+    std::shared_ptr<CircuitBreaker> breaker_;
+    // Declared last so it is destroyed (and its threads joined) first.
+    std::unique_ptr<FetchExecutor> fetchExecutor_;
 
-    void cleanupCache() {
-        if (cache_.size() > maxCacheSize_) {
-            TimePoint now = std::chrono::steady_clock::now();
-            auto it = cache_.begin();
-            while (it != cache_.end()) {
-                if (it->second.first < now) {
-                    it = cache_.erase(it);
+    struct FetchHandle {
+        std::shared_future<Value> result;
+        // Whoever reports first (the fetch, or a leader that timed out)
+        // tells the breaker; the other stays quiet.
+        std::shared_ptr<std::atomic<bool>> reported;
+    };
+
+    // Queues fetchFunc_ on the fetch executor and publishes the outcome
+    // through a shared future. Dropping the future never blocks, so a caller
+    // that times out can return while the fetch keeps running. Returns
+    // nothing if the executor is saturated. The caller has already missed
+    // the second tier; the fetched value is written back to it.
+    std::optional<FetchHandle> startFetch(const Key& key) {
+        auto promise = std::make_shared<std::promise<Value>>();
+        FetchHandle handle{promise->get_future().share(), std::make_shared<std::atomic<bool>>(false)};
+        bool queued = fetchExecutor_->trySubmit([fetch = fetchFunc_, key, promise, secondTier = secondTier_,
+                                                 expiryTime = expiryTime_, breaker = breaker_,
+                                                 reported = handle.reported]() {
+            try {
+                Value value = fetch(key);
+                if (!reported->exchange(true)) {
+                    breaker->onSuccess();
+                }
+                if (secondTier) {
+                    secondTier->put(key, value, std::chrono::system_clock::now() + expiryTime);
+                }
+                promise->set_value(std::move(value));
+            }
+            catch (const KeyNotFound&) {
+                // A definite answer from a healthy downstream.
+                if (!reported->exchange(true)) {
+                    breaker->onSuccess();
+                }
+                promise->set_exception(std::current_exception());
+            }
+            catch (...) {
+                if (!reported->exchange(true)) {
+                    breaker->onFailure();
+                }
+                promise->set_exception(std::current_exception());
+            }
+        });
+        if (!queued) {
+            return std::nullopt;
+        }
+        return handle;
+    }
+
+    // Batched counterpart of startFetch: one executor task resolves every
+    // key with a single fetchMany call. Returns false if the executor is
+    // saturated.
+    bool startBatchFetch(const std::vector<Key>& keys, const std::vector<std::shared_ptr<std::promise<Value>>>& promises,
+                         std::shared_ptr<std::atomic<bool>> reported) {
+        return fetchExecutor_->trySubmit([this, keys, promises, reported]() {
+            try {
+                std::unordered_map<Key, Value> values;
+                if (fetchMany_) {
+                    values = fetchMany_(keys);
                 }
                 else {
-                    ++it;
+                    for (const Key& key : keys) {
+                        try {
+                            values.emplace(key, fetchFunc_(key));
+                        }
+                        catch (const KeyNotFound&) {
+                        }
+                    }
+                }
+                if (!reported->exchange(true)) {
+                    breaker_->onSuccess();
+                }
+
+                for (std::size_t i = 0; i < keys.size(); ++i) {
+                    auto value = values.find(keys[i]);
+                    if (value == values.end()) {
+                        promises[i]->set_exception(std::make_exception_ptr(KeyNotFound()));
+                        continue;
+                    }
+                    if (secondTier_) {
+                        secondTier_->put(keys[i], value->second, std::chrono::system_clock::now() + expiryTime_);
+                    }
+                    promises[i]->set_value(value->second);
+                }
+            }
+            catch (...) {
+                if (!reported->exchange(true)) {
+                    breaker_->onFailure();
+                }
+                for (const auto& promise : promises) {
+                    promise->set_exception(std::current_exception());
+                }
+            }
+        });
+    }
+
+    // On a hit, expiresAt is the deadline the value was stored with, moved
+    // onto the steady clock, so promoting it into the shard doesn't extend it.
+    std::optional<Value> fromSecondTier(const Key& key, TimePoint& expiresAt) {
+        if (!secondTier_) {
+            return std::nullopt;
+        }
+        std::chrono::system_clock::time_point storedExpiry;
+        std::optional<Value> stored = secondTier_->get(key, &storedExpiry);
+        if (stored) {
+            auto remaining = std::min<std::chrono::system_clock::duration>(
+                storedExpiry - std::chrono::system_clock::now(), expiryTime_);
+            expiresAt = std::chrono::steady_clock::now() +
+                        std::chrono::duration_cast<std::chrono::steady_clock::duration>(remaining);
+        }
+        return stored;
+    }
+
+    bool ruledOut(const Key& key) {
+        if (existenceFilter_ && !existenceFilter_->mightContain(key)) {
+            filteredKeys_.fetch_add(1, std::memory_order_relaxed);
+            return true;
+        }
+        return false;
+    }
+
+    // Caller holds shard.mutex.
+    bool knownAbsent(Shard& shard, const Key& key, TimePoint now) {
+        auto it = shard.absent.find(key);
+        if (it == shard.absent.end() || it->second <= now) {
+            return false;
+        }
+        negativeHits_.fetch_add(1, std::memory_order_relaxed);
+        return true;
+    }
+
+    // Caller holds shard.mutex. Negative entries count against neither
+    // budget, so they are capped at the shard's entry limit instead.
+    void insertAbsent(Shard& shard, const Key& key) {
+        if (negativeTtl_.count() <= 0) {
+            return;
+        }
+        auto existing = shard.entries.find(key);
+        if (existing != shard.entries.end()) {
+            erase(shard, existing);
+        }
+        if (shard.absent.size() >= maxShardSize_ && shard.absent.count(key) == 0) {
+            return;
+        }
+        TimePoint until = std::chrono::steady_clock::now() + negativeTtl_;
+        shard.absent[key] = until;
+        shard.expiry.schedule(key, until);
+    }
+
+    Shard& shardFor(const Key& key) {
+        return *shards_[std::hash<Key>{}(key) % shards_.size()];
+    }
+
+    bool overBudget(const Shard& shard) const {
+        return shard.entries.size() > maxShardSize_ || shard.bytes > maxShardBytes_;
+    }
+
+    // Caller holds shard.mutex. A value bigger than the whole shard budget
+    // is returned to the caller but never cached, so it can't flush the shard.
+    void insert(Shard& shard, const Key& key, const Value& value) {
+        insert(shard, key, value, std::chrono::steady_clock::now() + expiryTime_);
+    }
+
+    void insert(Shard& shard, const Key& key, const Value& value, TimePoint expiresAt) {
+        shard.absent.erase(key);
+        auto existing = shard.entries.find(key);
+        if (existing != shard.entries.end()) {
+            erase(shard, existing);
+        }
+
+        std::size_t bytes = sizer_(key, value);
+        if (bytes > maxShardBytes_) {
+            return;
+        }
+
+        shard.recency.push_front(key);
+        shard.entries.emplace(key, Entry{expiresAt, value, bytes, shard.recency.begin()});
+        shard.expiry.schedule(key, expiresAt);
+        shard.bytes += bytes;
+        residentBytes_.fetch_add(bytes, std::memory_order_relaxed);
+        cleanupShard(shard);
+    }
+
+    // Caller holds shard.mutex.
+    void erase(Shard& shard, typename std::unordered_map<Key, Entry>::iterator it) {
+        shard.bytes -= it->second.bytes;
+        residentBytes_.fetch_sub(it->second.bytes, std::memory_order_relaxed);
+        shard.recency.erase(it->second.recency);
+        shard.expiry.cancel(it->first);
+        shard.entries.erase(it);
+    }
+
+    // Caller holds shard.mutex. Drops up to `budget` entries whose deadline
+    // has passed.
+    void expire(Shard& shard, TimePoint now, std::size_t budget) {
+        shard.expiry.advance(now, [this, &shard](const Key& key) {
+            auto it = shard.entries.find(key);
+            if (it != shard.entries.end()) {
+                erase(shard, it);
+            }
+            else {
+                shard.absent.erase(key);
+            }
+        }, budget);
+    }
+
+    // Caller holds shard.mutex.
+    void cleanupShard(Shard& shard) {
+        if (!overBudget(shard)) {
+            return;
+        }
+
+        expire(shard, std::chrono::steady_clock::now(), std::numeric_limits<std::size_t>::max());
+
+        while (overBudget(shard) && !shard.recency.empty()) {
+            auto victim = shard.entries.find(shard.recency.back());
+            evictedBytes_.fetch_add(victim->second.bytes, std::memory_order_relaxed);
+            evictedEntries_.fetch_add(1, std::memory_order_relaxed);
+            erase(shard, victim);
+        }
+    }
+};
+
+// Read-optimised variant of Cache for read-mostly data: get() on a hit takes
+// no lock and writes nothing shared except one striped counter.
+//
+// The entries live in an immutable snapshot. Writers (misses, remove) copy
+// it under writeMutex_, publish the copy with a single pointer store, and
+// free the old snapshot only after a grace period, in the style of userspace
+// RCU: readers announce themselves on one of two epoch counters, and the
+// writer flips the epoch and waits for each counter to drain, twice, so no
+// reader can still hold the old pointer. Every write copies the map, which is
+// the right trade only when reads outnumber writes by orders of magnitude;
+// concurrent misses on one key still share a single fetch.
+template <typename Key, typename Value>
+class ReadMostlyCache {
+public:
+    using TimePoint = std::chrono::time_point<std::chrono::steady_clock>;
+
+    ReadMostlyCache(std::chrono::seconds expiryTime, std::function<Value(const Key&)> fetchFunc,
+                    std::size_t maxCacheSize)
+        : expiryTime_(expiryTime), fetchFunc_(fetchFunc), maxCacheSize_(std::max<std::size_t>(maxCacheSize, 1)),
+          current_(new Snapshot()), epoch_(0) {}
+
+    ~ReadMostlyCache() {
+        delete current_.load();
+    }
+
+    ReadMostlyCache(const ReadMostlyCache&) = delete;
+    ReadMostlyCache& operator=(const ReadMostlyCache&) = delete;
+
+    Value get(const Key& key) {
+        {
+            ReadGuard guard(*this);
+            const Snapshot* snapshot = current_.load(std::memory_order_seq_cst);
+            auto it = snapshot->entries.find(key);
+            if (it != snapshot->entries.end() && std::chrono::steady_clock::now() < it->second->expiresAt) {
+                return it->second->value;
+            }
+        }
+
+        std::shared_future<Value> pending;
+        bool leader = false;
+        std::shared_ptr<std::promise<Value>> promise;
+        {
+            std::lock_guard<std::mutex> lock(missMutex_);
+            auto inFlight = inFlight_.find(key);
+            if (inFlight != inFlight_.end()) {
+                pending = inFlight->second;
+            }
+            else {
+                promise = std::make_shared<std::promise<Value>>();
+                pending = promise->get_future().share();
+                inFlight_.emplace(key, pending);
+                leader = true;
+            }
+        }
+
+        if (leader) {
+            try {
+                Value value = fetchFunc_(key);
+                publish([&](Entries& entries) {
+                    entries[key] = std::make_shared<const Entry>(
+                        Entry{std::chrono::steady_clock::now() + expiryTime_, value});
+                });
+                promise->set_value(value);
+            }
+            catch (...) {
+                promise->set_exception(std::current_exception());
+            }
+            std::lock_guard<std::mutex> lock(missMutex_);
+            inFlight_.erase(key);
+        }
+        return pending.get();
+    }
+
+    void remove(const Key& key) {
+        publish([&](Entries& entries) { entries.erase(key); });
+    }
+
+private:
+    struct Entry {
+        TimePoint expiresAt;
+        Value value;
+    };
+
+    // Entries are shared between snapshots, so copying a snapshot copies
+    // pointers, not values.
+    using Entries = std::unordered_map<Key, std::shared_ptr<const Entry>>;
+
+    struct Snapshot {
+        Entries entries;
+    };
+
+    static constexpr std::size_t kReaderStripes = 16;
+
+    struct alignas(64) ReaderCount {
+        std::atomic<std::size_t> active{0};
+    };
+
+    class ReadGuard {
+    public:
+        explicit ReadGuard(ReadMostlyCache& cache)
+            : counter_(cache.readers_[cache.epoch_.load(std::memory_order_seq_cst)][stripe()].active) {
+            counter_.fetch_add(1, std::memory_order_seq_cst);
+        }
+        ~ReadGuard() {
+            counter_.fetch_sub(1, std::memory_order_release);
+        }
+
+    private:
+        static std::size_t stripe() {
+            static thread_local std::size_t index = std::hash<std::thread::id>{}(std::this_thread::get_id()) % kReaderStripes;
+            return index;
+        }
+
+        std::atomic<std::size_t>& counter_;
+    };
+
+    // Copies the current snapshot, lets `change` edit the copy, trims it to
+    // size and publishes it; then waits out the readers of the old one.
+    template <typename Change>
+    void publish(Change&& change) {
+        std::lock_guard<std::mutex> lock(writeMutex_);
+        const Snapshot* old = current_.load(std::memory_order_relaxed);
+        std::unique_ptr<Snapshot> next(new Snapshot(*old));
+        change(next->entries);
+        trim(next->entries);
+        current_.store(next.release(), std::memory_order_seq_cst);
+
+        waitForReaders();
+        waitForReaders();
+        delete old;
+    }
+
+    // Caller holds writeMutex_. Flips the epoch so new readers use the other
+    // counter, then waits for everyone on the previous one to leave.
+    void waitForReaders() {
+        std::size_t previous = epoch_.load(std::memory_order_relaxed);
+        epoch_.store(previous ^ 1, std::memory_order_seq_cst);
+        for (ReaderCount& count : readers_[previous]) {
+            while (count.active.load(std::memory_order_acquire) != 0) {
+                std::this_thread::yield();
+            }
+        }
+    }
+
+    // Drops expired entries, then the ones closest to expiry, until the map
+    // fits in maxCacheSize_. Only runs on the (rare) write path.
+    void trim(Entries& entries) {
+        if (entries.size() <= maxCacheSize_) {
+            return;
+        }
+        TimePoint now = std::chrono::steady_clock::now();
+        for (auto it = entries.begin(); it != entries.end();) {
+            it = it->second->expiresAt < now ? entries.erase(it) : std::next(it);
+        }
+        while (entries.size() > maxCacheSize_) {
+            auto oldest = entries.begin();
+            for (auto it = entries.begin(); it != entries.end(); ++it) {
+                if (it->second->expiresAt < oldest->second->expiresAt) {
+                    oldest = it;
                 }
             }
+            entries.erase(oldest);
         }
     }
+
+    std::chrono::seconds expiryTime_;
+    std::function<Value(const Key&)> fetchFunc_;
+    std::size_t maxCacheSize_;
+    std::atomic<const Snapshot*> current_;
+    std::atomic<std::size_t> epoch_;
+    ReaderCount readers_[2][kReaderStripes];
+    std::mutex writeMutex_;
+    std::mutex missMutex_;
+    std::unordered_map<Key, std::shared_future<Value>> inFlight_;
 };
 
+#ifndef APPLICATION_CACHING_NO_MAIN
 // Example usage
 int main() {
+    // Single-flight: concurrent misses on one key trigger a single fetch
+    {
+        std::atomic<int> fetches(0);
+        auto countingFetch = [&fetches](const std::string& key) {
+            ++fetches;
+            std::this_thread::sleep_for(std::chrono::milliseconds(100));
+            return key + " value";
+        };
+        Cache<std::string, std::string> coalescing(std::chrono::seconds(5), countingFetch, 10);
+
+        std::vector<std::thread> callers;
+        for (int i = 0; i < 8; ++i) {
+            callers.emplace_back([&coalescing]() { coalescing.get("hot"); });
+        }
+        for (std::thread& caller : callers) {
+            caller.join();
+        }
+        std::cout << "8 concurrent misses caused " << fetches.load() << " fetch(es)" << std::endl;
+    }
+
+    // Byte budget: 64 KiB across 4 shards, with 4 KiB values, keeps at most
+    // a few values per shard no matter how many keys are requested.
+    {
+        auto bigFetch = [](const int& key) { return std::string(4096, static_cast<char>('a' + key % 26)); };
+        Cache<int, std::string> budgeted(std::chrono::seconds(60), bigFetch, 1000, 4, 64 * 1024);
+        for (int key = 0; key < 100; ++key) {
+            budgeted.get(key);
+        }
+        CacheStats stats = budgeted.stats();
+        std::cout << "Resident bytes: " << stats.residentBytes << ", evicted bytes: " << stats.evictedBytes
+                  << " (" << stats.evictedEntries << " entries)" << std::endl;
+    }
+
+    // Second tier: a fresh Cache over the same file (as after a restart) is
+    // served from disk instead of calling the fetch function again.
+    {
+        std::atomic<int> fetches(0);
+        auto countingFetch = [&fetches](const std::string& key) {
+            ++fetches;
+            return key + " value";
+        };
+        for (int run = 0; run < 2; ++run) {
+            Cache<std::string, std::string> restarted(std::chrono::seconds(60), countingFetch, 10);
+            restarted.setSecondTier(
+                std::make_shared<mmap_cache_tier::L2Tier<std::string, std::string>>("application_cache.l2", 1024));
+            restarted.get("warm");
+        }
+        std::cout << "2 starts over one L2 file caused " << fetches.load() << " fetch(es)" << std::endl;
+    }
+
+    // Circuit breaker: two failures open it, misses are rejected while it is
+    // open, and after 200ms one probe is let through and closes it again.
+    {
+        std::atomic<bool> downstreamUp(false);
+        auto flakyFetch = [&downstreamUp](const int& key) {
+            if (!downstreamUp) {
+                throw std::runtime_error("downstream unavailable");
+            }
+            return std::to_string(key);
+        };
+        Cache<int, std::string> guarded(std::chrono::seconds(60), flakyFetch, 100);
+        FetchPolicy policy;
+        policy.failureThreshold = 2;
+        policy.openDuration = std::chrono::milliseconds(200);
+        guarded.setFetchPolicy(policy);
+
+        for (int key = 0; key < 4; ++key) {
+            try {
+                guarded.get(key);
+            }
+            catch (const std::exception&) {
+            }
+        }
+        downstreamUp = true;
+        std::this_thread::sleep_for(std::chrono::milliseconds(250));
+        std::string recovered = guarded.get(42);
+        std::cout << "After recovery: " << recovered << ", breaker rejections: "
+                  << guarded.stats().breakerRejections << std::endl;
+    }
+
+    // Read-mostly variant: same get() interface, lock-free hits.
+    {
+        ReadMostlyCache<std::string, std::string> readMostly(std::chrono::seconds(60),
+                                                             [](const std::string& key) { return key + " value"; }, 100);
+        std::vector<std::thread> readers;
+        std::atomic<int> hits(0);
+        for (int i = 0; i < 4; ++i) {
+            readers.emplace_back([&readMostly, &hits]() {
+                for (int n = 0; n < 10000; ++n) {
+                    if (readMostly.get("report-" + std::to_string(n % 10)).size() > 0) {
+                        ++hits;
+                    }
+                }
+            });
+        }
+        for (std::thread& reader : readers) {
+            reader.join();
+        }
+        std::cout << "Read-mostly cache served " << hits.load() << " reads" << std::endl;
+    }
+
+    // Batched lookups: one fetchMany round trip for all misses, absent keys
+    // remembered, and keys outside the existence filter never fetched.
+    {
+        std::atomic<int> roundTrips(0);
+        auto fetchOne = [](const int& key) -> std::string {
+            if (key % 2 != 0) {
+                throw KeyNotFound();
+            }
+            return std::to_string(key);
+        };
+        Cache<int, std::string> batched(std::chrono::seconds(60), fetchOne, 1000);
+        batched.setFetchMany([&roundTrips](const std::vector<int>& keys) {
+            ++roundTrips;
+            std::unordered_map<int, std::string> values;
+            for (int key : keys) {
+                if (key % 2 == 0) {
+                    values.emplace(key, std::to_string(key));
+                }
+            }
+            return values;
+        });
+        batched.setNegativeTtl(std::chrono::seconds(30));
+        auto existing = std::make_shared<BloomFilter<int>>(1000);
+        for (int key = 0; key < 200; ++key) {
+            existing->add(key);
+        }
+        batched.setExistenceFilter(existing);
+
+        std::vector<int> keys;
+        for (int key = 0; key < 100; ++key) {
+            keys.push_back(key);
+        }
+        std::size_t firstFound = batched.getMany(keys).size();
+        keys.push_back(100000); // never added to the filter
+        std::size_t secondFound = batched.getMany(keys).size();
+        CacheStats stats = batched.stats();
+        std::cout << "getMany found " << firstFound << " then " << secondFound << " of " << keys.size()
+                  << " keys in " << roundTrips.load() << " round trip(s); negative hits: " << stats.negativeHits
+                  << ", filtered: " << stats.filteredKeys << std::endl;
+    }
+
     // Simulating a slow fetch function
     auto slowFetchFunc = [](const std::string& key) {
         std::this_thread::sleep_for(std::chrono::seconds(3));
@@ -114,3 +1253,4 @@ int main() {
 
     return 0;
 }
+#endif
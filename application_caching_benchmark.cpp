@@ -0,0 +1,93 @@
+#define APPLICATION_CACHING_NO_MAIN
+#include "application_caching.cpp"
+
+#include <algorithm>
+#include <random>
+#include <string>
+#include <vector>
+
+// Multi-threaded hit/miss benchmark for Cache<Key, Value>. A set of hot keys
+// is preloaded; every thread then mixes hits on those keys with misses on
+// never-seen keys whose fetch takes 200us. With one shard every hit shares a
+// lock with every miss insert; with many shards they mostly don't.
+// ReadMostlyCache runs the same workload: its hits take no lock at all, but
+// every miss copies the whole map.
+//
+// Prints one CSV row per (cache, shards, threads) combination.
+
+namespace {
+    using Clock = std::chrono::steady_clock;
+
+    constexpr int kHotKeys = 1000;
+    constexpr int kOpsPerThread = 20000;
+    constexpr int kMissEvery = 50; // 2% misses
+
+    struct RunResult {
+        double opsPerSec;
+        double hitP99Us;
+    };
+
+    std::string slowFetch(const int& key) {
+        std::this_thread::sleep_for(std::chrono::microseconds(200));
+        return std::to_string(key);
+    }
+
+    template <typename CacheType>
+    RunResult run(CacheType& cache, int threads) {
+        for (int key = 0; key < kHotKeys; ++key) {
+            cache.get(key);
+        }
+
+        std::atomic<int> nextColdKey(kHotKeys);
+        std::vector<std::vector<double>> hitLatencies(threads);
+        std::vector<std::thread> workers;
+
+        Clock::time_point start = Clock::now();
+        for (int t = 0; t < threads; ++t) {
+            workers.emplace_back([&, t]() {
+                std::mt19937 random(t);
+                std::uniform_int_distribution<int> hotKey(0, kHotKeys - 1);
+                hitLatencies[t].reserve(kOpsPerThread);
+                for (int op = 0; op < kOpsPerThread; ++op) {
+                    if (op % kMissEvery == 0) {
+                        cache.get(nextColdKey.fetch_add(1));
+                        continue;
+                    }
+                    Clock::time_point before = Clock::now();
+                    cache.get(hotKey(random));
+                    hitLatencies[t].push_back(std::chrono::duration<double, std::micro>(Clock::now() - before).count());
+                }
+            });
+        }
+        for (std::thread& worker : workers) {
+            worker.join();
+        }
+        double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+
+        std::vector<double> hits;
+        for (const auto& perThread : hitLatencies) {
+            hits.insert(hits.end(), perThread.begin(), perThread.end());
+        }
+        std::sort(hits.begin(), hits.end());
+
+        return {threads * kOpsPerThread / seconds, hits[static_cast<std::size_t>(0.99 * (hits.size() - 1))]};
+    }
+}
+
+int main() {
+    std::cout << "cache,shards,threads,ops_per_sec,hit_p99_us" << std::endl;
+    for (std::size_t shards : {1, 16, 64}) {
+        for (int threads : {1, 4, 8, 16}) {
+            Cache<int, std::string> cache(std::chrono::seconds(60), slowFetch, 1 << 20, shards);
+            RunResult result = run(cache, threads);
+            std::cout << "sharded," << shards << "," << threads << "," << result.opsPerSec << "," << result.hitP99Us
+                      << std::endl;
+        }
+    }
+    for (int threads : {1, 4, 8, 16}) {
+        ReadMostlyCache<int, std::string> cache(std::chrono::seconds(60), slowFetch, 1 << 20);
+        RunResult result = run(cache, threads);
+        std::cout << "read_mostly,," << threads << "," << result.opsPerSec << "," << result.hitP99Us << std::endl;
+    }
+    return 0;
+}
@@ -1,41 +1,475 @@
 #include <iostream>
 #include <unordered_map>
 #include <vector>
-#include <deque>
 #include <chrono>
 #include <algorithm>
+#include <array>
+#include <cstdint>
+#include <functional>
+#include <list>
+
+#include <memory>
+
+#include "mmap_cache_tier.h"
+#include "timing_wheel.h"
 
 using namespace std;
 
+// Eviction policies. Each one tracks which keys are resident and decides what
+// to drop, all in O(1) per operation; the owning cache keeps the values.
+//   Policy(size_t capacity)
+//   void onHit(const Key&)                   a resident key was read
+//   void onInsert(const Key&, Evict evict)   a new key became resident; calls
+//                                            evict(k) for every key it pushes
+//                                            out (possibly the new key itself)
+//   void onErase(const Key&)                 the cache dropped a key itself
+
+// Least recently used: hash map into an intrusive recency list.
+template <typename Key>
+class LruPolicy {
+public:
+    explicit LruPolicy(size_t capacity) : capacity(max<size_t>(capacity, 1)) {}
+
+    void onHit(const Key& key) {
+        auto it = index.find(key);
+        if (it != index.end()) {
+            order.splice(order.begin(), order, it->second);
+        }
+    }
+
+    template <typename Evict>
+    void onInsert(const Key& key, Evict&& evict) {
+        order.push_front(key);
+        index[key] = order.begin();
+        while (order.size() > capacity) {
+            Key victim = order.back();
+            order.pop_back();
+            index.erase(victim);
+            evict(victim);
+        }
+    }
+
+    void onErase(const Key& key) {
+        auto it = index.find(key);
+        if (it != index.end()) {
+            order.erase(it->second);
+            index.erase(it);
+        }
+    }
+
+private:
+    size_t capacity;
+    list<Key> order;  // most recent first
+    unordered_map<Key, typename list<Key>::iterator> index;
+};
+
+// Least frequently used, ties broken by recency: keys live in one list per
+// access count and minFrequency tracks the lowest non-empty list.
+template <typename Key>
+class LfuPolicy {
+public:
+    explicit LfuPolicy(size_t capacity) : capacity(max<size_t>(capacity, 1)) {}
+
+    void onHit(const Key& key) {
+        auto it = index.find(key);
+        if (it == index.end()) {
+            return;
+        }
+
+        Entry& entry = it->second;
+        list<Key>& from = buckets[entry.frequency];
+        from.erase(entry.position);
+        if (from.empty()) {
+            buckets.erase(entry.frequency);
+            if (minFrequency == entry.frequency) {
+                ++minFrequency;
+            }
+        }
+
+        ++entry.frequency;
+        list<Key>& to = buckets[entry.frequency];
+        to.push_front(key);
+        entry.position = to.begin();
+    }
+
+    template <typename Evict>
+    void onInsert(const Key& key, Evict&& evict) {
+        if (index.size() >= capacity) {
+            list<Key>& coldest = buckets[minFrequency];
+            Key victim = coldest.back();
+            coldest.pop_back();
+            if (coldest.empty()) {
+                buckets.erase(minFrequency);
+            }
+            index.erase(victim);
+            evict(victim);
+        }
+
+        list<Key>& fresh = buckets[1];
+        fresh.push_front(key);
+        index[key] = Entry{1, fresh.begin()};
+        minFrequency = 1;
+    }
+
+    void onErase(const Key& key) {
+        auto it = index.find(key);
+        if (it == index.end()) {
+            return;
+        }
+
+        list<Key>& bucket = buckets[it->second.frequency];
+        bucket.erase(it->second.position);
+        if (bucket.empty()) {
+            buckets.erase(it->second.frequency);
+            if (minFrequency == it->second.frequency) {
+                minFrequency = buckets.empty() ? 1 : recomputeMinFrequency();
+            }
+        }
+        index.erase(it);
+    }
+
+private:
+    struct Entry {
+        size_t frequency;
+        typename list<Key>::iterator position;
+    };
+
+    // Only needed after an external erase empties the lowest bucket.
+    size_t recomputeMinFrequency() const {
+        size_t lowest = SIZE_MAX;
+        for (const auto& bucket : buckets) {
+            lowest = min(lowest, bucket.first);
+        }
+        return lowest;
+    }
+
+    size_t capacity;
+    size_t minFrequency = 1;
+    unordered_map<Key, Entry> index;
+    unordered_map<size_t, list<Key>> buckets;  // each list most recent first
+};
+
+// Adaptive Replacement Cache (Megiddo & Modha). T1/T2 hold resident keys
+// seen once / more than once; B1/B2 remember recently evicted keys from each
+// and steer the target size p of T1.
+template <typename Key>
+class ArcPolicy {
+public:
+    explicit ArcPolicy(size_t capacity) : capacity(max<size_t>(capacity, 1)) {}
+
+    void onHit(const Key& key) {
+        auto it = index.find(key);
+        if (it != index.end() && (it->second.list == T1 || it->second.list == T2)) {
+            moveTo(it->second, T2);
+        }
+    }
+
+    template <typename Evict>
+    void onInsert(const Key& key, Evict&& evict) {
+        auto it = index.find(key);
+        if (it != index.end() && it->second.list == B1) {
+            target = min(capacity, target + max<size_t>(lists[B2].size() / max<size_t>(lists[B1].size(), 1), 1));
+            replace(false, evict);
+            moveTo(it->second, T2);
+            return;
+        }
+        if (it != index.end() && it->second.list == B2) {
+            size_t step = max<size_t>(lists[B1].size() / max<size_t>(lists[B2].size(), 1), 1);
+            target = target > step ? target - step : 0;
+            replace(true, evict);
+            moveTo(it->second, T2);
+            return;
+        }
+
+        size_t l1 = lists[T1].size() + lists[B1].size();
+        size_t total = l1 + lists[T2].size() + lists[B2].size();
+        if (l1 >= capacity) {
+            if (lists[T1].size() < capacity) {
+                dropLru(B1);
+                replace(false, evict);
+            }
+            else {
+                Key victim = lists[T1].back();
+                dropLru(T1);
+                evict(victim);
+            }
+        }
+        else if (total >= capacity) {
+            if (total >= 2 * capacity) {
+                dropLru(B2);
+            }
+            replace(false, evict);
+        }
+
+        lists[T1].push_front(key);
+        index[key] = Entry{T1, lists[T1].begin()};
+    }
+
+    void onErase(const Key& key) {
+        auto it = index.find(key);
+        if (it != index.end() && (it->second.list == T1 || it->second.list == T2)) {
+            lists[it->second.list].erase(it->second.position);
+            index.erase(it);
+        }
+    }
+
+private:
+    enum ListId { T1, T2, B1, B2 };
+
+    struct Entry {
+        ListId list;
+        typename list<Key>::iterator position;
+    };
+
+    void moveTo(Entry& entry, ListId to) {
+        lists[to].splice(lists[to].begin(), lists[entry.list], entry.position);
+        entry.list = to;
+    }
+
+    void dropLru(ListId from) {
+        if (!lists[from].empty()) {
+            index.erase(lists[from].back());
+            lists[from].pop_back();
+        }
+    }
+
+    // Frees one resident slot by demoting the LRU of T1 or T2 to its ghost
+    // list. Only acts when the resident lists are actually full, which keeps
+    // ARC's invariants even after external erases.
+    template <typename Evict>
+    void replace(bool hitInB2, Evict&& evict) {
+        if (lists[T1].size() + lists[T2].size() < capacity) {
+            return;
+        }
+
+        ListId from = (!lists[T1].empty() && (lists[T1].size() > target || (hitInB2 && lists[T1].size() == target)))
+                          ? T1
+                          : T2;
+        if (lists[from].empty()) {
+            from = from == T1 ? T2 : T1;
+        }
+        Key victim = lists[from].back();
+        moveTo(index[victim], from == T1 ? B1 : B2);
+        evict(victim);
+    }
+
+    size_t capacity;
+    size_t target = 0;
+    array<list<Key>, 4> lists;  // each list most recent first
+    unordered_map<Key, Entry> index;
+};
+
+// Window TinyLFU (as in Caffeine): new keys enter a small LRU window; when
+// the window overflows its LRU key competes with the main region's eviction
+// candidate, and the one with the higher estimated frequency stays. The main
+// region is a segmented LRU (probation/protected). Frequencies come from a
+// 4-bit count-min sketch that is halved periodically so old popularity fades.
+template <typename Key>
+class WTinyLfuPolicy {
+public:
+    explicit WTinyLfuPolicy(size_t capacity)
+        : capacity(max<size_t>(capacity, 2)),
+          windowCapacity(max<size_t>(this->capacity / 100, 1)),
+          protectedCapacity((this->capacity - windowCapacity) * 4 / 5),
+          sketch(this->capacity) {}
+
+    void onHit(const Key& key) {
+        sketch.increment(key);
+        auto it = index.find(key);
+        if (it == index.end()) {
+            return;
+        }
+
+        Entry& entry = it->second;
+        if (entry.segment == Probation) {
+            moveTo(entry, Protected);
+            if (segments[Protected].size() > protectedCapacity) {
+                moveTo(index[segments[Protected].back()], Probation);
+            }
+        }
+        else {
+            moveTo(entry, entry.segment);
+        }
+    }
+
+    template <typename Evict>
+    void onInsert(const Key& key, Evict&& evict) {
+        sketch.increment(key);
+        segments[Window].push_front(key);
+        index[key] = Entry{Window, segments[Window].begin()};
+
+        if (segments[Window].size() <= windowCapacity) {
+            return;
+        }
+
+        Key candidate = segments[Window].back();
+        moveTo(index[candidate], Probation);
+        if (segments[Probation].size() + segments[Protected].size() <= capacity - windowCapacity) {
+            return;
+        }
+
+        // Main region is over capacity: the candidate (now probation MRU)
+        // duels the probation LRU, or the protected LRU if probation only
+        // holds the candidate.
+        Segment victimSegment = segments[Probation].size() > 1 ? Probation : Protected;
+        Key victim = segments[victimSegment].back();
+        Key loser = sketch.estimate(candidate) > sketch.estimate(victim) ? victim : candidate;
+
+        Entry& lost = index[loser];
+        segments[lost.segment].erase(lost.position);
+        index.erase(loser);
+        evict(loser);
+    }
+
+    void onErase(const Key& key) {
+        auto it = index.find(key);
+        if (it != index.end()) {
+            segments[it->second.segment].erase(it->second.position);
+            index.erase(it);
+        }
+    }
+
+private:
+    enum Segment { Window, Probation, Protected };
+
+    struct Entry {
+        Segment segment;
+        typename list<Key>::iterator position;
+    };
+
+    class FrequencySketch {
+    public:
+        explicit FrequencySketch(size_t capacity) {
+            width = 16;
+            while (width < capacity * 2) {
+                width <<= 1;
+            }
+            counters.assign(width * kRows, 0);
+            resetAfter = capacity * 10;
+        }
+
+        void increment(const Key& key) {
+            size_t h = hash<Key>{}(key);
+            for (size_t row = 0; row < kRows; ++row) {
+                uint8_t& counter = counters[row * width + slot(h, row)];
+                if (counter < 15) {
+                    ++counter;
+                }
+            }
+            if (++additions >= resetAfter) {
+                for (uint8_t& counter : counters) {
+                    counter >>= 1;
+                }
+                additions /= 2;
+            }
+        }
+
+        uint8_t estimate(const Key& key) const {
+            size_t h = hash<Key>{}(key);
+            uint8_t lowest = 15;
+            for (size_t row = 0; row < kRows; ++row) {
+                lowest = min(lowest, counters[row * width + slot(h, row)]);
+            }
+            return lowest;
+        }
+
+    private:
+        static constexpr size_t kRows = 4;
+
+        size_t slot(size_t h, size_t row) const {
+            uint64_t mixed = (static_cast<uint64_t>(h) + row) * 0x9E3779B97F4A7C15ULL;
+            mixed ^= mixed >> 32;
+            return static_cast<size_t>(mixed) & (width - 1);
+        }
+
+        size_t width;
+        vector<uint8_t> counters;
+        size_t additions = 0;
+        size_t resetAfter;
+    };
+
+    void moveTo(Entry& entry, Segment to) {
+        segments[to].splice(segments[to].begin(), segments[entry.segment], entry.position);
+        entry.segment = to;
+    }
+
+    size_t capacity;
+    size_t windowCapacity;
+    size_t protectedCapacity;
+    array<list<Key>, 3> segments;  // each list most recent first
+    unordered_map<Key, Entry> index;
+    FrequencySketch sketch;
+};
+
+template <typename EvictionPolicy = LruPolicy<string>>
 class LiftWaitService {
 private:
+    static constexpr size_t CACHE_SIZE = 100;  // Maximum cache size
+    static constexpr chrono::seconds TTL{300};
+    static constexpr size_t EXPIRY_STEP_BUDGET = 4;  // expired entries dropped per call
     unordered_map<string, pair<chrono::system_clock::time_point, vector<int>>> cache;
-    deque<string> accessOrder;
-    const int CACHE_SIZE = 100;  // Maximum cache size
+    EvictionPolicy policy{CACHE_SIZE};
+    // Active expiry: entries past their TTL are dropped a few at a time on
+    // each call instead of lingering until evicted.
+    timing_wheel::TimingWheel<string, chrono::system_clock> expiry{chrono::seconds(1)};
+    // Optional persistent tier consulted before the API.
+    shared_ptr<mmap_cache_tier::L2Tier<string, vector<int>>> secondTier;
 
 public:
+    explicit LiftWaitService(shared_ptr<mmap_cache_tier::L2Tier<string, vector<int>>> secondTier = nullptr)
+        : secondTier(move(secondTier)) {}
+
     vector<int> getLiftWaits(const string& resort) {
-        if (cache.find(resort) != cache.end()) {
-            const auto& cachedData = cache[resort];
-            if (cachedData.first + chrono::seconds(300) > chrono::system_clock::now()) {
+        chrono::system_clock::time_point now = chrono::system_clock::now();
+        expiry.advance(now, [this](const string& expiredKey) {
+            cache.erase(expiredKey);
+            policy.onErase(expiredKey);
+        }, EXPIRY_STEP_BUDGET);
+
+        auto cached = cache.find(resort);
+        if (cached != cache.end()) {
+            const auto& cachedData = cached->second;
+            if (cachedData.first + TTL > now) {
                 cout << "Returning cached lift wait times for " << resort << endl;
-                updateAccessOrder(resort);  // Update the access order
+                policy.onHit(resort);  // Update the access order
                 return cachedData.second;
             }
         }
 
-        vector<int> liftWaitTimes = getLiftWaitTimesFromAPI(resort);
-
-        // Update cache with new data
-        cache[resort] = { chrono::system_clock::now(), liftWaitTimes };
-        updateAccessOrder(resort);  // Update the access order
+        // The second tier keeps the original fetch time, so a value loaded
+        // from it expires when it would have in the process that fetched it.
+        vector<int> liftWaitTimes;
+        chrono::system_clock::time_point storedUntil;
+        optional<vector<int>> stored = secondTier ? secondTier->get(resort, &storedUntil) : nullopt;
+        if (stored) {
+            cout << "Returning stored lift wait times for " << resort << endl;
+            liftWaitTimes = move(*stored);
+            now = storedUntil - TTL;
+        }
+        else {
+            liftWaitTimes = getLiftWaitTimesFromAPI(resort);
+            now = chrono::system_clock::now();
+            if (secondTier) {
+                secondTier->put(resort, liftWaitTimes, now + TTL);
+            }
+        }
 
-        // Evict the least recently used item if the cache exceeds the maximum size
-        if (cache.size() > CACHE_SIZE) {
-            const string& evictKey = accessOrder.front();
-            cache.erase(evictKey);
-            accessOrder.pop_front();
-            cout << "Evicted cache entry for " << evictKey << endl;
+        // Refresh an expired entry in place; otherwise let the policy admit
+        // the new key and evict whatever it chooses.
+        if (cached != cache.end()) {
+            cached->second = { now, liftWaitTimes };
+            policy.onHit(resort);
+        }
+        else {
+            cache[resort] = { now, liftWaitTimes };
+            policy.onInsert(resort, [this](const string& evictKey) {
+                cache.erase(evictKey);
+                expiry.cancel(evictKey);
+                cout << "Evicted cache entry for " << evictKey << endl;
+            });
+        }
+        if (cache.count(resort)) {
+            expiry.schedule(resort, now + TTL);
         }
 
         return liftWaitTimes;
@@ -57,21 +491,24 @@ private:
 
         return liftWaitTimes;
     }
-
-    void updateAccessOrder(const string& resort) {
-        // Update the access order by moving the resort to the back of the deque
-        auto it = std::find(accessOrder.begin(), accessOrder.end(), resort);
-        if (it != accessOrder.end()) {
-            accessOrder.erase(it);
-        }
-        accessOrder.push_back(resort);
-    }
 };
 
+#ifndef LIFT_WAIT_SERVICE_NO_MAIN
 int main() {
-    LiftWaitService service;
+    LiftWaitService<> service;
     vector<int> waitTimes = service.getLiftWaits("resort1");
     // Use the waitTimes...
 
+    LiftWaitService<WTinyLfuPolicy<string>> tinyLfuService;
+    tinyLfuService.getLiftWaits("resort1");
+    tinyLfuService.getLiftWaits("resort1");
+
+    // Warm restart: the second service finds resort2 in the mapped file.
+    for (int run = 0; run < 2; ++run) {
+        LiftWaitService<> restarted(make_shared<mmap_cache_tier::L2Tier<string, vector<int>>>("lift_waits.l2", 1024));
+        restarted.getLiftWaits("resort2");
+    }
+
     return 0;
 }
+#endif
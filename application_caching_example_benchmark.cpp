@@ -0,0 +1,111 @@
+#define LIFT_WAIT_SERVICE_NO_MAIN
+#include "application_caching_example.cpp"
+
+#include <cmath>
+#include <random>
+#include <unordered_set>
+
+// Trace replay for the LiftWaitService eviction policies. Each trace is
+// replayed against every policy at the same capacity, and the benchmark
+// reports hit ratio and ns/op:
+//   zipf        Zipfian (s = 0.99) requests over 100k keys
+//   zipf_scan   the same, interrupted every 20k requests by a sequential
+//               scan of 5k never-repeated keys (one-hit wonders that a
+//               frequency- or ghost-aware policy should not let flush the
+//               hot set)
+//
+// Prints one CSV row per (trace, capacity, policy).
+
+namespace {
+    using Clock = chrono::steady_clock;
+
+    constexpr size_t kKeySpace = 100000;
+    constexpr size_t kRequests = 1000000;
+
+    vector<uint64_t> zipfTrace(uint64_t seed) {
+        vector<double> cdf(kKeySpace);
+        double sum = 0;
+        for (size_t rank = 0; rank < kKeySpace; ++rank) {
+            sum += 1.0 / pow(static_cast<double>(rank + 1), 0.99);
+            cdf[rank] = sum;
+        }
+
+        mt19937_64 random(seed);
+        uniform_real_distribution<double> uniform(0, sum);
+        vector<uint64_t> trace;
+        trace.reserve(kRequests);
+        for (size_t i = 0; i < kRequests; ++i) {
+            trace.push_back(lower_bound(cdf.begin(), cdf.end(), uniform(random)) - cdf.begin());
+        }
+        return trace;
+    }
+
+    vector<uint64_t> scanTrace(uint64_t seed) {
+        vector<uint64_t> hot = zipfTrace(seed);
+        vector<uint64_t> trace;
+        trace.reserve(kRequests + kRequests / 4);
+        uint64_t nextScanKey = kKeySpace;
+        for (size_t i = 0; i < hot.size(); ++i) {
+            if (i % 20000 == 0) {
+                for (int scanned = 0; scanned < 5000; ++scanned) {
+                    trace.push_back(nextScanKey++);
+                }
+            }
+            trace.push_back(hot[i]);
+        }
+        return trace;
+    }
+
+    struct ReplayResult {
+        double hitRatio;
+        double nsPerOp;
+    };
+
+    // Drives a policy the same way LiftWaitService does, with a plain set
+    // standing in for the value map.
+    template <typename Policy>
+    ReplayResult replay(const vector<uint64_t>& trace, size_t capacity) {
+        Policy policy(capacity);
+        unordered_set<uint64_t> resident;
+        resident.reserve(capacity * 2);
+        size_t hits = 0;
+
+        Clock::time_point start = Clock::now();
+        for (uint64_t key : trace) {
+            if (resident.count(key)) {
+                ++hits;
+                policy.onHit(key);
+                continue;
+            }
+            resident.insert(key);
+            policy.onInsert(key, [&resident](const uint64_t& evicted) { resident.erase(evicted); });
+        }
+        double nanos = chrono::duration<double, nano>(Clock::now() - start).count();
+
+        return {static_cast<double>(hits) / trace.size(), nanos / trace.size()};
+    }
+
+    template <typename Policy>
+    void report(const char* traceName, const char* policyName, const vector<uint64_t>& trace, size_t capacity) {
+        ReplayResult result = replay<Policy>(trace, capacity);
+        cout << traceName << "," << capacity << "," << policyName << "," << result.hitRatio << "," << result.nsPerOp
+             << endl;
+    }
+}
+
+int main() {
+    vector<pair<const char*, vector<uint64_t>>> traces;
+    traces.emplace_back("zipf", zipfTrace(1));
+    traces.emplace_back("zipf_scan", scanTrace(2));
+
+    cout << "trace,capacity,policy,hit_ratio,ns_per_op" << endl;
+    for (const auto& trace : traces) {
+        for (size_t capacity : {1000, 10000}) {
+            report<LruPolicy<uint64_t>>(trace.first, "lru", trace.second, capacity);
+            report<LfuPolicy<uint64_t>>(trace.first, "lfu", trace.second, capacity);
+            report<ArcPolicy<uint64_t>>(trace.first, "arc", trace.second, capacity);
+            report<WTinyLfuPolicy<uint64_t>>(trace.first, "w_tinylfu", trace.second, capacity);
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,240 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace group_commit
+{
+
+    struct SyncPolicy
+    {
+        std::size_t batchBytes = 256 * 1024;     // write and sync as soon as this much is pending...
+        std::chrono::microseconds maxDelay{0};   // ...or once the oldest pending record has waited this long
+        bool sync = true;                        // false: acknowledge once written, leave syncing to the OS
+        std::size_t maxPendingBytes = 64 << 20;  // append() blocks while this much is waiting
+    };
+
+    struct GroupCommitStats
+    {
+        std::uint64_t records = 0;
+        std::uint64_t bytes = 0;
+        std::uint64_t batches = 0;
+        std::uint64_t syncs = 0;
+        std::uint64_t failedBatches = 0;
+        std::uint64_t callbackErrors = 0; // callbacks that threw
+    };
+
+    // Group commit in front of a durable store. Producers append records
+    // into a shared buffer and get a future (or a callback) back; one
+    // flusher thread takes everything pending, hands it to `write` as one
+    // batch, calls `sync` once for the whole batch, and then completes
+    // every record in it with the position `write` reported for it. So each
+    // caller still learns when *its* record is durable, but the store sees
+    // one write and one fdatasync per batch rather than per record.
+    //
+    // The flusher starts a batch once batchBytes are pending or the oldest
+    // pending record is maxDelay old. With maxDelay 0 (the default) it
+    // starts as soon as it is idle, so a batch is whatever piled up while
+    // the previous one was being synced; a small delay trades latency for
+    // bigger batches under light load.
+    //
+    // If write or sync throws, every record in that batch fails with the
+    // exception. Callbacks run on the flusher thread, so keep them short; an
+    // exception thrown by one is counted in callbackErrors and dropped, so
+    // the rest of the batch still completes.
+    template <typename Position>
+    class GroupCommitWriter
+    {
+    public:
+        using WriteBatch = std::function<void(const std::vector<std::string> &, std::vector<Position> &)>;
+        using Sync = std::function<void()>;
+        using Callback = std::function<void(Position, std::exception_ptr)>;
+
+        // write(records, positions) must store the records in order and
+        // fill positions with one entry per record.
+        GroupCommitWriter(WriteBatch write, Sync sync, SyncPolicy policy = SyncPolicy())
+            : write_(std::move(write)), sync_(std::move(sync)), policy_(policy),
+              flusher_([this]() { flushLoop(); })
+        {
+        }
+
+        ~GroupCommitWriter() { close(); }
+
+        GroupCommitWriter(const GroupCommitWriter &) = delete;
+        GroupCommitWriter &operator=(const GroupCommitWriter &) = delete;
+
+        // Completes with the record's position once it is durable.
+        std::future<Position> append(std::string record)
+        {
+            auto promise = std::make_shared<std::promise<Position>>();
+            std::future<Position> result = promise->get_future();
+            append(std::move(record), [promise](Position position, std::exception_ptr error) {
+                if (error)
+                    promise->set_exception(error);
+                else
+                    promise->set_value(position);
+            });
+            return result;
+        }
+
+        // Calls done(position, nullptr) once the record is durable, or
+        // done(Position(), error) if writing or syncing it failed.
+        void append(std::string record, Callback done)
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            room_.wait(lock, [this]() { return closed_ || pendingBytes_ < policy_.maxPendingBytes; });
+            if (closed_)
+            {
+                lock.unlock();
+                done(Position(), std::make_exception_ptr(std::logic_error("group_commit: writer is closed")));
+                return;
+            }
+
+            if (records_.empty())
+                oldest_ = Clock::now();
+            pendingBytes_ += record.size();
+            records_.push_back(std::move(record));
+            callbacks_.push_back(std::move(done));
+            ++appended_;
+            if (records_.size() == 1 || pendingBytes_ >= policy_.batchBytes)
+                work_.notify_one();
+        }
+
+        // Blocks until everything appended before the call is durable (or
+        // has failed), without waiting out maxDelay.
+        void flush()
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            std::uint64_t target = appended_;
+            urgent_ = true;
+            work_.notify_one();
+            done_.wait(lock, [&]() { return completed_ >= target; });
+        }
+
+        // Flushes what is pending and stops the flusher; later appends
+        // fail. Called by the destructor.
+        void close()
+        {
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                if (closed_)
+                    return;
+                closed_ = true;
+            }
+            work_.notify_one();
+            room_.notify_all();
+            flusher_.join();
+        }
+
+        GroupCommitStats stats() const
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            return stats_;
+        }
+
+    private:
+        using Clock = std::chrono::steady_clock;
+
+        void flushLoop()
+        {
+            std::vector<std::string> records;
+            std::vector<Callback> callbacks;
+            std::vector<Position> positions;
+            std::unique_lock<std::mutex> lock(mutex_);
+            while (true)
+            {
+                work_.wait(lock, [this]() { return closed_ || !records_.empty(); });
+                if (records_.empty())
+                    break; // closed and drained
+
+                if (policy_.maxDelay > std::chrono::microseconds::zero())
+                    work_.wait_until(lock, oldest_ + policy_.maxDelay, [this]() {
+                        return closed_ || urgent_ || pendingBytes_ >= policy_.batchBytes;
+                    });
+                urgent_ = false;
+
+                records.swap(records_);
+                callbacks.swap(callbacks_);
+                std::size_t bytes = pendingBytes_;
+                pendingBytes_ = 0;
+                lock.unlock();
+                room_.notify_all();
+
+                std::exception_ptr error;
+                positions.clear();
+                try
+                {
+                    write_(records, positions);
+                    if (policy_.sync)
+                        sync_();
+                }
+                catch (...)
+                {
+                    error = std::current_exception();
+                }
+                if (!error && positions.size() != records.size())
+                    error = std::make_exception_ptr(std::logic_error("group_commit: write reported the wrong number of positions"));
+
+                std::uint64_t callbackErrors = 0;
+                for (std::size_t i = 0; i < callbacks.size(); ++i)
+                {
+                    try
+                    {
+                        callbacks[i](error ? Position() : positions[i], error);
+                    }
+                    catch (...)
+                    {
+                        ++callbackErrors;
+                    }
+                }
+
+                lock.lock();
+                stats_.callbackErrors += callbackErrors;
+                completed_ += records.size();
+                stats_.records += records.size();
+                stats_.bytes += bytes;
+                ++stats_.batches;
+                if (policy_.sync && !error)
+                    ++stats_.syncs;
+                if (error)
+                    ++stats_.failedBatches;
+                records.clear();
+                callbacks.clear();
+                done_.notify_all();
+            }
+        }
+
+        WriteBatch write_;
+        Sync sync_;
+        SyncPolicy policy_;
+
+        mutable std::mutex mutex_;
+        std::condition_variable work_; // wakes the flusher
+        std::condition_variable room_; // wakes appenders waiting on maxPendingBytes
+        std::condition_variable done_; // wakes flush()
+        std::vector<std::string> records_;
+        std::vector<Callback> callbacks_;
+        std::size_t pendingBytes_ = 0;
+        Clock::time_point oldest_;
+        std::uint64_t appended_ = 0;
+        std::uint64_t completed_ = 0;
+        bool urgent_ = false;
+        bool closed_ = false;
+        GroupCommitStats stats_;
+
+        std::thread flusher_; // last, so it starts after everything it uses
+    };
+
+}
@@ -0,0 +1,156 @@
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <future>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "group_commit.h"
+#include "segmented_log.h"
+
+// Durable append throughput into a SegmentedLog. Every producer appends its
+// share of 100-byte records; the sweep covers 1, 4 and 16 producers for:
+//   sync_per_record   append + fdatasync per record, serialised on a mutex
+//                     (what flushing after every record costs)
+//   group_commit      GroupCommitWriter, each producer waits for its record
+//                     to be durable before sending the next
+//   group_commit_2ms  the same with maxDelay = 2ms, so the flusher lingers
+//                     for bigger batches
+//   pipelined         GroupCommitWriter, producers don't wait (callbacks
+//                     count acknowledgements)
+//   no_sync           append only, never synced (the upper bound)
+//
+// Prints one CSV row per (mode, producers), with the average batch size for
+// the group commit modes. The log lives in the system temp directory and is
+// deleted after each run.
+//
+// Usage: group_commit_benchmark [--quick]
+
+namespace
+{
+    using Clock = std::chrono::steady_clock;
+
+    enum class Mode
+    {
+        SyncPerRecord,
+        GroupCommit,
+        GroupCommitLinger,
+        Pipelined,
+        NoSync
+    };
+
+    const char *modeName(Mode mode)
+    {
+        switch (mode)
+        {
+        case Mode::SyncPerRecord:
+            return "sync_per_record";
+        case Mode::GroupCommit:
+            return "group_commit";
+        case Mode::GroupCommitLinger:
+            return "group_commit_2ms";
+        case Mode::Pipelined:
+            return "pipelined";
+        case Mode::NoSync:
+            return "no_sync";
+        }
+        return "unknown";
+    }
+
+    struct Result
+    {
+        double recordsPerSecond;
+        double averageBatch;
+    };
+
+    Result run(Mode mode, int producers, std::size_t records)
+    {
+        std::filesystem::path directory = std::filesystem::temp_directory_path() / "group_commit_benchmark";
+        std::filesystem::remove_all(directory);
+        std::size_t perProducer = records / producers;
+        const std::string payload(100, 'x');
+        Result result{0, 0};
+
+        {
+            segmented_log::SegmentedLog log(directory.string());
+            group_commit::SyncPolicy policy;
+            if (mode == Mode::GroupCommitLinger)
+                policy.maxDelay = std::chrono::milliseconds(2);
+            group_commit::GroupCommitWriter<std::uint64_t> writer(
+                [&log](const std::vector<std::string> &batch, std::vector<std::uint64_t> &offsets) {
+                    std::uint64_t first = log.appendBatch(batch);
+                    for (std::size_t i = 0; i < batch.size(); ++i)
+                        offsets.push_back(first + i);
+                },
+                [&log]() { log.sync(); }, policy);
+            std::mutex syncMutex;
+            std::atomic<std::size_t> acknowledged(0);
+
+            Clock::time_point start = Clock::now();
+            std::vector<std::thread> threads;
+            for (int p = 0; p < producers; ++p)
+            {
+                threads.emplace_back([&]() {
+                    for (std::size_t i = 0; i < perProducer; ++i)
+                    {
+                        switch (mode)
+                        {
+                        case Mode::SyncPerRecord:
+                        {
+                            std::lock_guard<std::mutex> lock(syncMutex);
+                            log.append(payload);
+                            log.sync();
+                            break;
+                        }
+                        case Mode::GroupCommit:
+                        case Mode::GroupCommitLinger:
+                            writer.append(payload).get();
+                            break;
+                        case Mode::Pipelined:
+                            writer.append(payload, [&acknowledged](std::uint64_t, std::exception_ptr) { ++acknowledged; });
+                            break;
+                        case Mode::NoSync:
+                            log.append(payload);
+                            break;
+                        }
+                    }
+                });
+            }
+            for (std::thread &thread : threads)
+                thread.join();
+            writer.flush();
+            double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+
+            group_commit::GroupCommitStats stats = writer.stats();
+            result.recordsPerSecond = perProducer * producers / seconds;
+            result.averageBatch = stats.batches == 0 ? 0 : static_cast<double>(stats.records) / stats.batches;
+            if (mode == Mode::Pipelined && acknowledged.load() != perProducer * producers)
+                std::cerr << "pipelined: missing acknowledgements" << std::endl;
+        }
+        std::filesystem::remove_all(directory);
+        return result;
+    }
+}
+
+int main(int argc, char **argv)
+{
+    bool quick = argc > 1 && std::strcmp(argv[1], "--quick") == 0;
+    const std::size_t records = quick ? 2000 : 20000;
+
+    std::cout << "mode,producers,records,records_per_sec,avg_batch" << std::endl;
+    for (Mode mode : {Mode::SyncPerRecord, Mode::GroupCommit, Mode::GroupCommitLinger, Mode::Pipelined, Mode::NoSync})
+    {
+        for (int producers : {1, 4, 16})
+        {
+            Result result = run(mode, producers, records);
+            std::cout << modeName(mode) << "," << producers << "," << records << "," << result.recordsPerSecond << ","
+                      << result.averageBatch << std::endl;
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,367 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#ifdef __linux__
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace mmap_cache_tier
+{
+
+    // Byte encoding for keys and values stored in the second tier. Covers
+    // strings, trivially copyable types and vectors of them; specialise for
+    // anything else.
+    template <typename T, typename = void>
+    struct Codec;
+
+    template <typename T>
+    struct Codec<T, std::enable_if_t<std::is_trivially_copyable<T>::value>>
+    {
+        static void encode(const T &value, std::string &out) { out.assign(reinterpret_cast<const char *>(&value), sizeof(T)); }
+        static std::optional<T> decode(const char *data, std::size_t size)
+        {
+            if (size != sizeof(T))
+                return std::nullopt;
+            T value;
+            std::memcpy(&value, data, sizeof(T));
+            return value;
+        }
+    };
+
+    template <>
+    struct Codec<std::string>
+    {
+        static void encode(const std::string &value, std::string &out) { out = value; }
+        static std::optional<std::string> decode(const char *data, std::size_t size) { return std::string(data, size); }
+    };
+
+    template <typename T>
+    struct Codec<std::vector<T>, std::enable_if_t<std::is_trivially_copyable<T>::value>>
+    {
+        static void encode(const std::vector<T> &value, std::string &out)
+        {
+            out.assign(reinterpret_cast<const char *>(value.data()), value.size() * sizeof(T));
+        }
+        static std::optional<std::vector<T>> decode(const char *data, std::size_t size)
+        {
+            if (size % sizeof(T) != 0)
+                return std::nullopt;
+            std::vector<T> value(size / sizeof(T));
+            std::memcpy(value.data(), data, size);
+            return value;
+        }
+    };
+
+    // A fixed-size hash table of byte records in a memory-mapped file, so its
+    // contents survive a restart.
+    //
+    // Layout: a header, then an index of slotCount 8-byte key hashes, then
+    // slotCount slots of slotSize bytes. Index entry i describes slot i
+    // (0 = empty, 1 = deleted), so a lookup probes the compact index and only
+    // touches the one slot whose hash matches. Each slot holds the absolute
+    // expiry (system_clock, so it means the same thing after a restart), the
+    // key and the value.
+    //
+    // Linear probing is capped at kMaxProbe slots; when every slot in that
+    // window is live, the one closest to expiry is overwritten, so the file
+    // never grows. Records that don't fit in a slot are not stored.
+    //
+    // The file is opened and mapped on first use, and pages are faulted in as
+    // they are touched rather than read up front. If it can't be opened (or
+    // on non-Linux builds) the tier disables itself and every lookup misses.
+    class SlotFile
+    {
+    public:
+        using TimePoint = std::chrono::system_clock::time_point;
+
+        SlotFile(std::string path, std::size_t slotCount, std::size_t slotSize)
+            : path_(std::move(path)), slotCount_(slotCount == 0 ? 1 : slotCount),
+              slotSize_(slotSize < sizeof(SlotHeader) + 1 ? sizeof(SlotHeader) + 1 : slotSize)
+        {
+        }
+
+        ~SlotFile()
+        {
+#ifdef __linux__
+            if (base_ != nullptr)
+                ::munmap(base_, mappedBytes_);
+            if (fd_ >= 0)
+                ::close(fd_);
+#endif
+        }
+
+        SlotFile(const SlotFile &) = delete;
+        SlotFile &operator=(const SlotFile &) = delete;
+
+        // On a hit, also reports the record's expiry if asked.
+        bool get(const std::string &key, std::string &value, TimePoint *expiresAt = nullptr)
+        {
+            TimePoint now = std::chrono::system_clock::now();
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (!ensureMapped())
+                return false;
+
+            std::uint64_t hash = hashKey(key);
+            std::size_t home = hash % slotCount_;
+            for (std::size_t probe = 0; probe < kMaxProbe && probe < slotCount_; ++probe)
+            {
+                std::size_t i = (home + probe) % slotCount_;
+                if (index()[i] == kEmpty)
+                    return false;
+                if (index()[i] != hash || !holdsKey(i, key))
+                    continue;
+
+                const SlotHeader &slot = header(i);
+                if (slot.expiresAtNanos <= toNanos(now))
+                {
+                    index()[i] = kDeleted;
+                    return false;
+                }
+                value.assign(payload(i) + slot.keySize, slot.valueSize);
+                if (expiresAt != nullptr)
+                    *expiresAt = TimePoint(std::chrono::duration_cast<TimePoint::duration>(
+                        std::chrono::nanoseconds(slot.expiresAtNanos)));
+                return true;
+            }
+            return false;
+        }
+
+        void put(const std::string &key, const std::string &value, TimePoint expiresAt)
+        {
+            if (sizeof(SlotHeader) + key.size() + value.size() > slotSize_)
+                return;
+
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (!ensureMapped())
+                return;
+
+            std::uint64_t hash = hashKey(key);
+            std::int64_t now = toNanos(std::chrono::system_clock::now());
+            std::size_t home = hash % slotCount_;
+            std::size_t target = slotCount_;
+            std::size_t soonest = home;
+            for (std::size_t probe = 0; probe < kMaxProbe && probe < slotCount_; ++probe)
+            {
+                std::size_t i = (home + probe) % slotCount_;
+                std::uint64_t entry = index()[i];
+                if (entry == hash && holdsKey(i, key))
+                {
+                    target = i;
+                    break;
+                }
+                bool reusable = entry == kEmpty || entry == kDeleted || header(i).expiresAtNanos <= now;
+                if (reusable && target == slotCount_)
+                    target = i;
+                if (entry == kEmpty)
+                    break;
+                if (!reusable && header(i).expiresAtNanos < header(soonest).expiresAtNanos)
+                    soonest = i;
+            }
+            if (target == slotCount_)
+                target = soonest;
+
+            // Hide the slot while it is rewritten, so a crash mid-write leaves
+            // a deleted entry rather than a torn one.
+            index()[target] = kDeleted;
+            std::atomic_thread_fence(std::memory_order_release);
+            SlotHeader &slot = header(target);
+            slot.expiresAtNanos = toNanos(expiresAt);
+            slot.keySize = static_cast<std::uint32_t>(key.size());
+            slot.valueSize = static_cast<std::uint32_t>(value.size());
+            std::memcpy(payload(target), key.data(), key.size());
+            std::memcpy(payload(target) + key.size(), value.data(), value.size());
+            std::atomic_thread_fence(std::memory_order_release);
+            index()[target] = hash;
+        }
+
+        void remove(const std::string &key)
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (!ensureMapped())
+                return;
+
+            std::uint64_t hash = hashKey(key);
+            std::size_t home = hash % slotCount_;
+            for (std::size_t probe = 0; probe < kMaxProbe && probe < slotCount_; ++probe)
+            {
+                std::size_t i = (home + probe) % slotCount_;
+                if (index()[i] == kEmpty)
+                    return;
+                if (index()[i] == hash && holdsKey(i, key))
+                {
+                    index()[i] = kDeleted;
+                    return;
+                }
+            }
+        }
+
+    private:
+        static constexpr std::uint64_t kMagic = 0x3253524549544c32ULL; // "2LTIERS2"
+        static constexpr std::uint32_t kVersion = 1;
+        static constexpr std::uint64_t kEmpty = 0;
+        static constexpr std::uint64_t kDeleted = 1;
+        static constexpr std::size_t kMaxProbe = 16;
+
+        struct FileHeader
+        {
+            std::uint64_t magic;
+            std::uint32_t version;
+            std::uint32_t slotSize;
+            std::uint64_t slotCount;
+            char reserved[40];
+        };
+
+        struct SlotHeader
+        {
+            std::int64_t expiresAtNanos;
+            std::uint32_t keySize;
+            std::uint32_t valueSize;
+        };
+
+        static std::uint64_t hashKey(const std::string &key)
+        {
+            std::uint64_t hash = 1469598103934665603ULL; // FNV-1a
+            for (unsigned char c : key)
+            {
+                hash ^= c;
+                hash *= 1099511628211ULL;
+            }
+            return hash > kDeleted ? hash : hash + 2;
+        }
+
+        static std::int64_t toNanos(TimePoint time)
+        {
+            return std::chrono::duration_cast<std::chrono::nanoseconds>(time.time_since_epoch()).count();
+        }
+
+        std::uint64_t *index() { return reinterpret_cast<std::uint64_t *>(base_ + sizeof(FileHeader)); }
+        char *slot(std::size_t i)
+        {
+            return base_ + sizeof(FileHeader) + slotCount_ * sizeof(std::uint64_t) + i * slotSize_;
+        }
+        SlotHeader &header(std::size_t i) { return *reinterpret_cast<SlotHeader *>(slot(i)); }
+        char *payload(std::size_t i) { return slot(i) + sizeof(SlotHeader); }
+
+        // Sizes come from the file, which may hold a torn or corrupt slot
+        // from an earlier run: one whose payload would overrun the slot is
+        // deleted and treated as a miss.
+        bool holdsKey(std::size_t i, const std::string &key)
+        {
+            const SlotHeader &slot = header(i);
+            if (sizeof(SlotHeader) + std::uint64_t(slot.keySize) + slot.valueSize > slotSize_)
+            {
+                index()[i] = kDeleted;
+                return false;
+            }
+            return slot.keySize == key.size() && std::memcmp(payload(i), key.data(), key.size()) == 0;
+        }
+
+        // Caller holds mutex_. Opens and maps the file the first time it is
+        // needed; a file written with a different geometry is reset.
+        bool ensureMapped()
+        {
+            if (base_ != nullptr)
+                return true;
+            if (failed_)
+                return false;
+
+#ifdef __linux__
+            std::size_t bytes = sizeof(FileHeader) + slotCount_ * (sizeof(std::uint64_t) + slotSize_);
+            fd_ = ::open(path_.c_str(), O_RDWR | O_CREAT, 0644);
+            struct stat info;
+            if (fd_ >= 0 && ::fstat(fd_, &info) == 0)
+            {
+                bool resize = static_cast<std::size_t>(info.st_size) != bytes;
+                if (!resize || ::ftruncate(fd_, static_cast<off_t>(bytes)) == 0)
+                {
+                    void *mapped = ::mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd_, 0);
+                    if (mapped != MAP_FAILED)
+                    {
+                        base_ = static_cast<char *>(mapped);
+                        mappedBytes_ = bytes;
+
+                        FileHeader &fileHeader = *reinterpret_cast<FileHeader *>(base_);
+                        if (fileHeader.magic != kMagic || fileHeader.version != kVersion ||
+                            fileHeader.slotSize != slotSize_ || fileHeader.slotCount != slotCount_)
+                        {
+                            std::memset(index(), 0, slotCount_ * sizeof(std::uint64_t));
+                            fileHeader = FileHeader{kMagic, kVersion, static_cast<std::uint32_t>(slotSize_), slotCount_, {}};
+                        }
+                        return true;
+                    }
+                }
+            }
+#endif
+            std::cerr << "L2 cache tier disabled: cannot map " << path_ << std::endl;
+            failed_ = true;
+            return false;
+        }
+
+        std::string path_;
+        std::size_t slotCount_;
+        std::size_t slotSize_;
+        std::mutex mutex_;
+        int fd_ = -1;
+        char *base_ = nullptr;
+        std::size_t mappedBytes_ = 0;
+        bool failed_ = false;
+    };
+
+    // Typed view over a SlotFile, used as an optional second tier behind an
+    // in-memory cache: L1 misses consult it before the downstream, and fresh
+    // values are written through to it.
+    template <typename Key, typename Value>
+    class L2Tier
+    {
+    public:
+        using TimePoint = SlotFile::TimePoint;
+
+        L2Tier(std::string path, std::size_t slotCount, std::size_t slotSize = 512)
+            : file_(std::move(path), slotCount, slotSize)
+        {
+        }
+
+        std::optional<Value> get(const Key &key, TimePoint *expiresAt = nullptr)
+        {
+            std::string encodedKey;
+            std::string bytes;
+            Codec<Key>::encode(key, encodedKey);
+            if (!file_.get(encodedKey, bytes, expiresAt))
+                return std::nullopt;
+            return Codec<Value>::decode(bytes.data(), bytes.size());
+        }
+
+        void put(const Key &key, const Value &value, TimePoint expiresAt)
+        {
+            std::string encodedKey;
+            std::string bytes;
+            Codec<Key>::encode(key, encodedKey);
+            Codec<Value>::encode(value, bytes);
+            file_.put(encodedKey, bytes, expiresAt);
+        }
+
+        void remove(const Key &key)
+        {
+            std::string encodedKey;
+            Codec<Key>::encode(key, encodedKey);
+            file_.remove(encodedKey);
+        }
+
+    private:
+        SlotFile file_;
+    };
+
+}
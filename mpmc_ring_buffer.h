@@ -0,0 +1,402 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <iterator>
+#include <mutex>
+#include <new>
+#include <thread>
+#include <type_traits>
+#include <utility>
+
+namespace mpmc_ring_buffer
+{
+
+    // Bounded lock-free multi-producer/multi-consumer queue (Dmitry Vyukov's
+    // design). Every cell carries a sequence number saying whose turn it is:
+    // a producer may fill cell i when its sequence equals the enqueue
+    // position, a consumer may empty it when it equals position + 1. A
+    // producer claims a position with one CAS on enqueuePos_, writes the
+    // value, then publishes it by bumping the cell's sequence; consumers
+    // mirror that on dequeuePos_. The two positions and every cell sit on
+    // their own cache lines so producers and consumers don't false-share.
+    //
+    // Three flavours of each operation:
+    //   tryEnqueue / tryDequeue     never wait; false if full (or closed) /
+    //                               empty
+    //   spinEnqueue / spinDequeue   retry with backoff until they succeed
+    //   enqueue / dequeue           spin briefly, then sleep until there is
+    //                               room / data or the queue is closed
+    // plus enqueueMany / dequeueMany, which claim a run of cells with a
+    // single CAS.
+    template <typename T>
+    class MpmcRingBuffer
+    {
+    public:
+        // Capacity is rounded up to a power of two.
+        explicit MpmcRingBuffer(std::size_t capacity)
+        {
+            std::size_t size = 2;
+            while (size < capacity)
+                size <<= 1;
+            mask_ = size - 1;
+            cells_ = new Cell[size];
+            for (std::size_t i = 0; i < size; ++i)
+                cells_[i].sequence.store(i, std::memory_order_relaxed);
+        }
+
+        ~MpmcRingBuffer()
+        {
+            std::size_t tail = enqueuePos_.value.load(std::memory_order_relaxed);
+            for (std::size_t pos = dequeuePos_.value.load(std::memory_order_relaxed); pos != tail; ++pos)
+                std::launder(cells_[pos & mask_].storage())->~T();
+            delete[] cells_;
+        }
+
+        MpmcRingBuffer(const MpmcRingBuffer &) = delete;
+        MpmcRingBuffer &operator=(const MpmcRingBuffer &) = delete;
+
+        std::size_t capacity() const { return mask_ + 1; }
+
+        // Approximate while other threads are running.
+        std::size_t size() const
+        {
+            std::size_t tail = enqueuePos_.value.load(std::memory_order_relaxed);
+            std::size_t head = dequeuePos_.value.load(std::memory_order_relaxed);
+            return tail > head ? tail - head : 0;
+        }
+
+        bool empty() const { return size() == 0; }
+
+        // False if full or closed.
+        template <typename U>
+        bool tryEnqueue(U &&value)
+        {
+            if (closed_.load(std::memory_order_acquire) || !tryPush(std::forward<U>(value)))
+                return false;
+            wakeConsumers();
+            return true;
+        }
+
+        bool tryDequeue(T &out)
+        {
+            if (!tryPop(out))
+                return false;
+            wakeProducers();
+            return true;
+        }
+
+        // Enqueues as many of [first, last) as fit, claiming them with one
+        // CAS; returns how many were taken (none once closed). They stay
+        // contiguous and in order.
+        template <typename Iterator>
+        std::size_t enqueueMany(Iterator first, Iterator last)
+        {
+            std::size_t wanted = static_cast<std::size_t>(std::distance(first, last));
+            if (wanted == 0 || closed_.load(std::memory_order_acquire))
+                return 0;
+
+            std::size_t pos = enqueuePos_.value.load(std::memory_order_relaxed);
+            std::size_t count = 0;
+            while (true)
+            {
+                count = 0;
+                bool moved = false;
+                while (count < wanted)
+                {
+                    std::size_t sequence = cells_[(pos + count) & mask_].sequence.load(std::memory_order_acquire);
+                    if (sequence != pos + count)
+                    {
+                        moved = count == 0 && static_cast<std::ptrdiff_t>(sequence - pos) > 0;
+                        break;
+                    }
+                    ++count;
+                }
+                if (count == 0)
+                {
+                    if (!moved)
+                        return 0; // full
+                    pos = enqueuePos_.value.load(std::memory_order_relaxed);
+                    continue;
+                }
+                if (enqueuePos_.value.compare_exchange_weak(pos, pos + count, std::memory_order_relaxed))
+                    break;
+            }
+
+            for (std::size_t i = 0; i < count; ++i, ++first)
+            {
+                Cell &cell = cells_[(pos + i) & mask_];
+                new (cell.storage()) T(std::move(*first));
+                cell.sequence.store(pos + i + 1, std::memory_order_release);
+            }
+            wakeConsumers();
+            return count;
+        }
+
+        // Dequeues up to maxCount values into out; returns how many.
+        template <typename OutputIterator>
+        std::size_t dequeueMany(OutputIterator out, std::size_t maxCount)
+        {
+            if (maxCount == 0)
+                return 0;
+
+            std::size_t pos = dequeuePos_.value.load(std::memory_order_relaxed);
+            std::size_t count = 0;
+            while (true)
+            {
+                count = 0;
+                bool moved = false;
+                while (count < maxCount)
+                {
+                    std::size_t sequence = cells_[(pos + count) & mask_].sequence.load(std::memory_order_acquire);
+                    if (sequence != pos + count + 1)
+                    {
+                        moved = count == 0 && static_cast<std::ptrdiff_t>(sequence - (pos + 1)) > 0;
+                        break;
+                    }
+                    ++count;
+                }
+                if (count == 0)
+                {
+                    if (!moved)
+                        return 0; // empty
+                    pos = dequeuePos_.value.load(std::memory_order_relaxed);
+                    continue;
+                }
+                if (dequeuePos_.value.compare_exchange_weak(pos, pos + count, std::memory_order_relaxed))
+                    break;
+            }
+
+            for (std::size_t i = 0; i < count; ++i)
+                takeFrom(cells_[(pos + i) & mask_], *out++, pos + i);
+            wakeProducers();
+            return count;
+        }
+
+        // Returns false once closed.
+        template <typename U>
+        bool spinEnqueue(U &&value)
+        {
+            for (unsigned attempt = 0; !tryEnqueue(std::forward<U>(value)); ++attempt)
+            {
+                if (closed_.load(std::memory_order_acquire))
+                    return false;
+                backoff(attempt);
+            }
+            return true;
+        }
+
+        void spinDequeue(T &out)
+        {
+            for (unsigned attempt = 0; !tryDequeue(out); ++attempt)
+                backoff(attempt);
+        }
+
+        // Blocks while full. Returns false (and drops nothing) once closed.
+        template <typename U>
+        bool enqueue(U &&value)
+        {
+            for (unsigned attempt = 0; attempt < kSpinsBeforeSleep; ++attempt)
+            {
+                if (closed_.load(std::memory_order_acquire))
+                    return false;
+                if (tryEnqueue(std::forward<U>(value)))
+                    return true;
+                backoff(attempt);
+            }
+
+            std::unique_lock<std::mutex> lock(mutex_);
+            sleepingProducers_.fetch_add(1, std::memory_order_seq_cst);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            bool done = false;
+            notFull_.wait(lock, [&]() {
+                if (closed_.load(std::memory_order_acquire))
+                    return true;
+                done = tryPush(std::forward<U>(value));
+                return done;
+            });
+            sleepingProducers_.fetch_sub(1, std::memory_order_relaxed);
+            lock.unlock();
+            if (done)
+                wakeConsumers();
+            return done;
+        }
+
+        // Blocks while empty. Returns false once the queue is closed and
+        // drained.
+        bool dequeue(T &out)
+        {
+            for (unsigned attempt = 0; attempt < kSpinsBeforeSleep; ++attempt)
+            {
+                if (tryDequeue(out))
+                    return true;
+                if (closed_.load(std::memory_order_acquire))
+                    return tryDequeue(out);
+                backoff(attempt);
+            }
+
+            std::unique_lock<std::mutex> lock(mutex_);
+            sleepingConsumers_.fetch_add(1, std::memory_order_seq_cst);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            bool done = false;
+            notEmpty_.wait(lock, [&]() {
+                done = tryPop(out);
+                return done || closed_.load(std::memory_order_acquire);
+            });
+            sleepingConsumers_.fetch_sub(1, std::memory_order_relaxed);
+            lock.unlock();
+            if (done)
+                wakeProducers();
+            return done || tryDequeue(out);
+        }
+
+        // Wakes every blocked caller. Every enqueue (blocking or not) fails
+        // from now on; dequeues keep draining what is left and fail once the
+        // queue is empty.
+        void close()
+        {
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                closed_.store(true, std::memory_order_release);
+            }
+            notEmpty_.notify_all();
+            notFull_.notify_all();
+        }
+
+    private:
+        static constexpr std::size_t kCacheLine = 64;
+        static constexpr unsigned kSpinsBeforeSleep = 64;
+
+        struct alignas(kCacheLine) Cell
+        {
+            std::atomic<std::size_t> sequence;
+            alignas(T) unsigned char bytes[sizeof(T)];
+
+            T *storage() { return reinterpret_cast<T *>(bytes); }
+        };
+
+        struct alignas(kCacheLine) Position
+        {
+            std::atomic<std::size_t> value{0};
+        };
+
+        // The lock-free cores of tryEnqueue / tryDequeue, without the wake-up
+        // (which takes mutex_, so the blocking paths call these under it).
+        template <typename U>
+        bool tryPush(U &&value)
+        {
+            std::size_t pos = enqueuePos_.value.load(std::memory_order_relaxed);
+            while (true)
+            {
+                Cell &cell = cells_[pos & mask_];
+                std::size_t sequence = cell.sequence.load(std::memory_order_acquire);
+                std::ptrdiff_t diff = static_cast<std::ptrdiff_t>(sequence) - static_cast<std::ptrdiff_t>(pos);
+                if (diff == 0)
+                {
+                    if (enqueuePos_.value.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                    {
+                        new (cell.storage()) T(std::forward<U>(value));
+                        cell.sequence.store(pos + 1, std::memory_order_release);
+                        return true;
+                    }
+                }
+                else if (diff < 0)
+                {
+                    return false; // full
+                }
+                else
+                {
+                    pos = enqueuePos_.value.load(std::memory_order_relaxed);
+                }
+            }
+        }
+
+        bool tryPop(T &out)
+        {
+            std::size_t pos = dequeuePos_.value.load(std::memory_order_relaxed);
+            while (true)
+            {
+                Cell &cell = cells_[pos & mask_];
+                std::size_t sequence = cell.sequence.load(std::memory_order_acquire);
+                std::ptrdiff_t diff = static_cast<std::ptrdiff_t>(sequence) - static_cast<std::ptrdiff_t>(pos + 1);
+                if (diff == 0)
+                {
+                    if (dequeuePos_.value.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                    {
+                        takeFrom(cell, out, pos);
+                        return true;
+                    }
+                }
+                else if (diff < 0)
+                {
+                    return false; // empty
+                }
+                else
+                {
+                    pos = dequeuePos_.value.load(std::memory_order_relaxed);
+                }
+            }
+        }
+
+        template <typename Destination>
+        void takeFrom(Cell &cell, Destination &&out, std::size_t pos)
+        {
+            T *stored = std::launder(cell.storage());
+            out = std::move(*stored);
+            stored->~T();
+            cell.sequence.store(pos + mask_ + 1, std::memory_order_release);
+        }
+
+        static void backoff(unsigned attempt)
+        {
+            if (attempt < 16)
+            {
+#if defined(__x86_64__) || defined(__i386__)
+                __builtin_ia32_pause();
+#endif
+            }
+            else
+            {
+                std::this_thread::yield();
+            }
+        }
+
+        // The seq_cst fence pairs with the sleeper's seq_cst increment: either
+        // we see the sleeper, or its re-check under the mutex sees our value.
+        void wakeConsumers()
+        {
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            if (sleepingConsumers_.load(std::memory_order_relaxed) > 0)
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                notEmpty_.notify_all();
+            }
+        }
+
+        void wakeProducers()
+        {
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            if (sleepingProducers_.load(std::memory_order_relaxed) > 0)
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                notFull_.notify_all();
+            }
+        }
+
+        Position enqueuePos_;
+        Position dequeuePos_;
+        Cell *cells_;
+        std::size_t mask_;
+
+        // Only touched by callers of the blocking variants once they give up
+        // spinning.
+        alignas(kCacheLine) std::atomic<int> sleepingProducers_{0};
+        std::atomic<int> sleepingConsumers_{0};
+        std::atomic<bool> closed_{false};
+        std::mutex mutex_;
+        std::condition_variable notEmpty_;
+        std::condition_variable notFull_;
+    };
+
+}
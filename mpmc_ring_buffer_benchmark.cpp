@@ -0,0 +1,236 @@
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <iostream>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "mpmc_ring_buffer.h"
+
+// Producer/consumer throughput for the MessageBroker queue. Every producer
+// pushes its share of the messages and every consumer pops until all of them
+// are through; the sweep covers 1-8 producers x 1-8 consumers for:
+//   blocking      enqueue / dequeue (spin, then sleep)
+//   spin          spinEnqueue / tryDequeue with backoff
+//   batch         enqueueMany / dequeueMany, 32 at a time
+//   mutex_queue   std::deque behind a mutex and two condition variables,
+//                 with the same capacity, as the baseline
+//
+// Prints one CSV row per (queue, producers, consumers).
+//
+// Usage: mpmc_ring_buffer_benchmark [--quick]
+
+namespace
+{
+    using Clock = std::chrono::steady_clock;
+    using RingBuffer = mpmc_ring_buffer::MpmcRingBuffer<std::uint64_t>;
+
+    constexpr std::size_t kCapacity = 1024;
+    constexpr std::size_t kBatch = 32;
+
+    class MutexQueue
+    {
+    public:
+        void enqueue(std::uint64_t value)
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            notFull.wait(lock, [this]() { return items.size() < kCapacity; });
+            items.push_back(value);
+            notEmpty.notify_one();
+        }
+
+        bool dequeue(std::uint64_t &value)
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            notEmpty.wait(lock, [this]() { return !items.empty() || closed; });
+            if (items.empty())
+                return false;
+            value = items.front();
+            items.pop_front();
+            notFull.notify_one();
+            return true;
+        }
+
+        void close()
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            closed = true;
+            notEmpty.notify_all();
+        }
+
+    private:
+        std::mutex mutex;
+        std::condition_variable notEmpty;
+        std::condition_variable notFull;
+        std::deque<std::uint64_t> items;
+        bool closed = false;
+    };
+
+    enum class Mode
+    {
+        Blocking,
+        Spin,
+        Batch,
+        Mutex
+    };
+
+    const char *modeName(Mode mode)
+    {
+        switch (mode)
+        {
+        case Mode::Blocking:
+            return "blocking";
+        case Mode::Spin:
+            return "spin";
+        case Mode::Batch:
+            return "batch";
+        case Mode::Mutex:
+            return "mutex_queue";
+        }
+        return "unknown";
+    }
+
+    void produce(Mode mode, RingBuffer &ring, MutexQueue &locked, std::uint64_t first, std::uint64_t count)
+    {
+        if (mode == Mode::Batch)
+        {
+            std::vector<std::uint64_t> batch;
+            for (std::uint64_t next = first; next < first + count;)
+            {
+                batch.clear();
+                for (std::size_t i = 0; i < kBatch && next + i < first + count; ++i)
+                    batch.push_back(next + i);
+                std::size_t sent = 0;
+                while (sent < batch.size())
+                {
+                    std::size_t taken = ring.enqueueMany(batch.begin() + sent, batch.end());
+                    sent += taken;
+                    if (taken == 0)
+                        std::this_thread::yield();
+                }
+                next += batch.size();
+            }
+            return;
+        }
+
+        for (std::uint64_t value = first; value < first + count; ++value)
+        {
+            if (mode == Mode::Blocking)
+                ring.enqueue(value);
+            else if (mode == Mode::Spin)
+                ring.spinEnqueue(value);
+            else
+                locked.enqueue(value);
+        }
+    }
+
+    // Returns the sum of everything consumed, so the work can't be elided and
+    // the total can be checked.
+    std::uint64_t consume(Mode mode, RingBuffer &ring, MutexQueue &locked, std::atomic<std::uint64_t> &remaining)
+    {
+        std::uint64_t sum = 0;
+        std::uint64_t value = 0;
+        if (mode == Mode::Blocking)
+        {
+            while (ring.dequeue(value))
+                sum += value;
+        }
+        else if (mode == Mode::Mutex)
+        {
+            while (locked.dequeue(value))
+                sum += value;
+        }
+        else if (mode == Mode::Spin)
+        {
+            while (remaining.load(std::memory_order_relaxed) > 0)
+            {
+                if (ring.tryDequeue(value))
+                {
+                    sum += value;
+                    remaining.fetch_sub(1, std::memory_order_relaxed);
+                }
+                else
+                {
+                    std::this_thread::yield();
+                }
+            }
+        }
+        else
+        {
+            std::vector<std::uint64_t> batch;
+            batch.reserve(kBatch);
+            while (remaining.load(std::memory_order_relaxed) > 0)
+            {
+                batch.clear();
+                std::size_t taken = ring.dequeueMany(std::back_inserter(batch), kBatch);
+                if (taken == 0)
+                {
+                    std::this_thread::yield();
+                    continue;
+                }
+                for (std::uint64_t item : batch)
+                    sum += item;
+                remaining.fetch_sub(taken, std::memory_order_relaxed);
+            }
+        }
+        return sum;
+    }
+
+    double run(Mode mode, int producers, int consumers, std::uint64_t messages)
+    {
+        RingBuffer ring(kCapacity);
+        MutexQueue locked;
+        std::atomic<std::uint64_t> remaining(messages);
+        std::atomic<std::uint64_t> total(0);
+        std::uint64_t perProducer = messages / producers;
+        messages = perProducer * producers;
+        remaining = messages;
+
+        Clock::time_point start = Clock::now();
+        std::vector<std::thread> consumerThreads;
+        for (int c = 0; c < consumers; ++c)
+            consumerThreads.emplace_back([&]() { total += consume(mode, ring, locked, remaining); });
+
+        std::vector<std::thread> producerThreads;
+        for (int p = 0; p < producers; ++p)
+            producerThreads.emplace_back([&, p]() { produce(mode, ring, locked, p * perProducer, perProducer); });
+        for (std::thread &producer : producerThreads)
+            producer.join();
+
+        // Blocking consumers stop when the queue is closed and drained.
+        ring.close();
+        locked.close();
+        for (std::thread &consumer : consumerThreads)
+            consumer.join();
+        double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+
+        if (total.load() != messages * (messages - 1) / 2)
+            std::cerr << modeName(mode) << ": lost or duplicated messages" << std::endl;
+        return messages / seconds;
+    }
+}
+
+int main(int argc, char **argv)
+{
+    bool quick = argc > 1 && std::strcmp(argv[1], "--quick") == 0;
+    const std::uint64_t messages = quick ? 100000 : 1000000;
+
+    std::cout << "queue,producers,consumers,messages,msgs_per_sec" << std::endl;
+    for (Mode mode : {Mode::Blocking, Mode::Spin, Mode::Batch, Mode::Mutex})
+    {
+        for (int producers : {1, 2, 4, 8})
+        {
+            for (int consumers : {1, 2, 4, 8})
+            {
+                double rate = run(mode, producers, consumers, messages);
+                std::cout << modeName(mode) << "," << producers << "," << consumers << "," << messages << ","
+                          << rate << std::endl;
+            }
+        }
+    }
+    return 0;
+}
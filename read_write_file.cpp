@@ -1,27 +1,105 @@
+#include <cerrno>
+#include <cstdint>
 #include <iostream>
-#include <fstream>
 #include <string>
+#include <system_error>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "group_commit.h"
 
 class DistributedLogStorage {
 private:
-    std::fstream logFile;  // File to store the log
+    int logFd;               // File to store the log
+    std::uint64_t logSize;   // Bytes in the log, i.e. the offset of the next event
+    group_commit::GroupCommitWriter<std::uint64_t> writer;  // Batches appends into one write + fdatasync
+
+    static int openLog(const std::string& logFilePath) {
+        int fd = ::open(logFilePath.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+        if (fd < 0) {
+            throw std::system_error(errno, std::generic_category(), "cannot open " + logFilePath);
+        }
+        return fd;
+    }
+
+    static std::uint64_t sizeOf(int fd) {
+        struct stat info;
+        return ::fstat(fd, &info) == 0 ? static_cast<std::uint64_t>(info.st_size) : 0;
+    }
+
+    // Writes a batch of events with a single write, each followed by a
+    // newline character to separate events, and reports where each starts
+    void writeEvents(const std::vector<std::string>& events, std::vector<std::uint64_t>& offsets) {
+        std::string batch;
+        std::uint64_t offset = logSize;
+        for (const std::string& event : events) {
+            offsets.push_back(offset);
+            batch += event;
+            batch += '\n';
+            offset += event.size() + 1;
+        }
+
+        const char* data = batch.data();
+        std::size_t remaining = batch.size();
+        while (remaining > 0) {
+            ssize_t written = ::pwrite(logFd, data, remaining, static_cast<off_t>(offset - remaining));
+            if (written < 0 && errno == EINTR) {
+                continue;
+            }
+            if (written <= 0) {
+                throw std::system_error(errno, std::generic_category(), "cannot append to log");
+            }
+            data += written;
+            remaining -= static_cast<std::size_t>(written);
+        }
+        logSize = offset;
+    }
+
+    void syncLog() {
+        if (::fdatasync(logFd) != 0) {
+            throw std::system_error(errno, std::generic_category(), "cannot sync log");
+        }
+    }
 
 public:
-    DistributedLogStorage(const std::string& logFilePath) {
-        logFile.open(logFilePath, std::ios::binary | std::ios::in | std::ios::out | std::ios::app);
+    DistributedLogStorage(const std::string& logFilePath,
+                          group_commit::SyncPolicy syncPolicy = group_commit::SyncPolicy())
+        : logFd(openLog(logFilePath)),
+          logSize(sizeOf(logFd)),
+          writer([this](const std::vector<std::string>& events, std::vector<std::uint64_t>& offsets) {
+                     writeEvents(events, offsets);
+                 },
+                 [this]() { syncLog(); }, syncPolicy) {}
+
+    ~DistributedLogStorage() {
+        writer.close();  // Write and sync whatever is still pending
+        ::close(logFd);
     }
 
-    void appendEvent(const std::string& event) {
-        logFile.write(event.data(), event.size());  // Append the event to the log file
-        logFile.put('\n');  // Add a newline character to separate events
-        logFile.flush();  // Flush the buffer to ensure the event is written immediately
+    // Append the event to the log. The future completes with the event's
+    // offset once it is on disk; events appended concurrently share a sync.
+    std::future<std::uint64_t> appendEvent(const std::string& event) {
+        return writer.append(event);
     }
 
-    std::string readEvent(size_t offset) {
+    std::string readEvent(std::uint64_t offset) {
         std::string event;
-        logFile.seekg(offset, std::ios::beg);  // Set the read position to the desired offset
-        std::getline(logFile, event);  // Read the event from the log file
-        return event;
+        char buffer[256];
+        while (true) {
+            ssize_t got = ::pread(logFd, buffer, sizeof(buffer), static_cast<off_t>(offset + event.size()));
+            if (got <= 0) {
+                return event;
+            }
+            for (ssize_t i = 0; i < got; ++i) {
+                if (buffer[i] == '\n') {
+                    return event.append(buffer, i);  // Read the event up to its newline
+                }
+            }
+            event.append(buffer, got);
+        }
     }
 };
 
@@ -29,14 +107,14 @@ int main() {
     DistributedLogStorage logStorage("log.txt");
 
     // Append events to the log
-    logStorage.appendEvent("Event 1");
-    logStorage.appendEvent("Event 2");
-    logStorage.appendEvent("Event 3");
-
-    // Read events from the log
-    std::string event1 = logStorage.readEvent(0);
-    std::string event2 = logStorage.readEvent(10);  // Read from offset 10
-    std::string event3 = logStorage.readEvent(20);  // Read from offset 20
+    std::future<std::uint64_t> offset1 = logStorage.appendEvent("Event 1");
+    std::future<std::uint64_t> offset2 = logStorage.appendEvent("Event 2");
+    std::future<std::uint64_t> offset3 = logStorage.appendEvent("Event 3");
+
+    // Read events from the log, at the offsets they were written to
+    std::string event1 = logStorage.readEvent(offset1.get());
+    std::string event2 = logStorage.readEvent(offset2.get());
+    std::string event3 = logStorage.readEvent(offset3.get());
 
     std::cout << "Event 1: " << event1 << std::endl;
     std::cout << "Event 2: " << event2 << std::endl;
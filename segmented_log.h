@@ -0,0 +1,778 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cerrno>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <system_error>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace segmented_log
+{
+
+    // CRC-32 (IEEE 802.3, reflected polynomial), table driven. Pass the
+    // previous result as `crc` to checksum several pieces as one.
+    inline std::uint32_t crc32(const void *data, std::size_t size, std::uint32_t crc = 0)
+    {
+        static const std::array<std::uint32_t, 256> table = []() {
+            std::array<std::uint32_t, 256> entries{};
+            for (std::uint32_t i = 0; i < 256; ++i)
+            {
+                std::uint32_t value = i;
+                for (int bit = 0; bit < 8; ++bit)
+                    value = (value & 1) ? 0xEDB88320u ^ (value >> 1) : value >> 1;
+                entries[i] = value;
+            }
+            return entries;
+        }();
+
+        const unsigned char *bytes = static_cast<const unsigned char *>(data);
+        crc = ~crc;
+        for (std::size_t i = 0; i < size; ++i)
+            crc = table[(crc ^ bytes[i]) & 0xFF] ^ (crc >> 8);
+        return ~crc;
+    }
+
+    // Throws std::system_error for the errno left by a failed call on path.
+    [[noreturn]] inline void fail(const std::string &what, const std::string &path)
+    {
+        throw std::system_error(errno, std::generic_category(), "segmented_log: " + what + " " + path);
+    }
+
+    struct LogOptions
+    {
+        std::uint64_t maxSegmentBytes = 64 * 1024 * 1024; // roll to a new segment past this (capped at 4 GiB)
+        std::uint64_t indexIntervalBytes = 4096;           // one sparse index entry per this many bytes
+    };
+
+    struct Record
+    {
+        std::uint64_t offset;
+        std::string payload;
+    };
+
+    // Append-only log of byte records, split into segment files in one
+    // directory.
+    //
+    // Every record gets a 64-bit offset (0, 1, 2, ...). A segment is named
+    // after the offset of its first record: 00000000000000000000.log holds
+    // records from offset 0 until it reaches maxSegmentBytes, then the next
+    // one starts. On disk a record is
+    //   u32 length | u32 crc32(length, payload) | payload
+    // (host byte order), so a torn or corrupt tail is recognised on open and
+    // cut off instead of being replayed as garbage; the length is under the
+    // CRC so a zero-filled hole doesn't pass as an empty record.
+    //
+    // Each segment has a sparse index (<base>.index) of
+    //   u32 offset - base | u32 byte position
+    // pairs, one per indexIntervalBytes of records, so read() seeks to the
+    // nearest entry at or before the wanted offset and scans at most one
+    // interval to find it. Indexes of older segments are loaded the first
+    // time they are read, and rebuilt from the segment if missing.
+    //
+    // Appends go through a file descriptor kept open on the active segment
+    // and are durable only after sync() (group_commit.h batches the two).
+    // Every call is serialised on one mutex. I/O errors throw
+    // std::system_error.
+    class SegmentedLog
+    {
+    public:
+        explicit SegmentedLog(std::string directory, LogOptions options = LogOptions())
+            : directory_(std::move(directory)), options_(options)
+        {
+            options_.maxSegmentBytes = std::min<std::uint64_t>(options_.maxSegmentBytes, UINT32_MAX);
+            options_.indexIntervalBytes = std::max<std::uint64_t>(options_.indexIntervalBytes, 1);
+
+            std::error_code error;
+            std::filesystem::create_directories(directory_, error);
+            if (error)
+                throw std::system_error(error, "segmented_log: cannot create " + directory_);
+
+            for (const auto &entry : std::filesystem::directory_iterator(directory_))
+            {
+                std::uint64_t base = 0;
+                if (entry.path().extension() == ".log" && parseBase(entry.path().stem().string(), base))
+                    segments_.emplace(base, std::make_unique<Segment>(base, segmentPath(base, ".log")));
+            }
+
+            if (segments_.empty())
+            {
+                segments_.emplace(0, std::make_unique<Segment>(0, segmentPath(0, ".log")));
+                openActive(*segments_.begin()->second, true);
+                return;
+            }
+
+            // Older segments end where the next one starts; only the active
+            // one has to be scanned to find its end.
+            for (auto it = segments_.begin(); std::next(it) != segments_.end(); ++it)
+                it->second->nextOffset = std::next(it)->first;
+            openActive(active(), false);
+        }
+
+        ~SegmentedLog()
+        {
+            for (auto &segment : segments_)
+                segment.second->closeFiles();
+        }
+
+        SegmentedLog(const SegmentedLog &) = delete;
+        SegmentedLog &operator=(const SegmentedLog &) = delete;
+
+        // Returns the record's offset.
+        std::uint64_t append(const std::string &payload) { return appendRange(&payload, &payload + 1); }
+
+        // Appends the records in order with one write per segment they land
+        // in; returns the first one's offset (the rest follow on). If it
+        // throws, a prefix of the batch may have been written.
+        std::uint64_t appendBatch(const std::vector<std::string> &payloads)
+        {
+            return appendRange(payloads.data(), payloads.data() + payloads.size());
+        }
+
+        // Makes everything appended so far durable: fdatasync on each
+        // segment written since the last sync, and fsync on the directory
+        // if a segment was created. The syncs run outside the log's mutex,
+        // so reads and appends carry on meanwhile. If one fails, whatever
+        // this call took on is left for the next sync() to retry.
+        void sync()
+        {
+            std::vector<Segment *> sealed;
+            std::vector<std::pair<int, std::string>> files;
+            bool directoryDirty = false;
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                sealed.swap(unsynced_);
+                for (Segment *segment : sealed)
+                    files.emplace_back(segment->fd, segment->path);
+                files.emplace_back(active().fd, active().path);
+                std::swap(directoryDirty, directoryDirty_);
+            }
+            try
+            {
+                // Descriptors of segments written by this process stay open
+                // until the log is destroyed, so these are still valid.
+                for (const auto &file : files)
+                    if (::fdatasync(file.first) != 0)
+                        fail("cannot sync", file.second);
+                if (directoryDirty)
+                {
+                    int fd = openFile(directory_, O_RDONLY | O_DIRECTORY);
+                    int result = ::fsync(fd);
+                    ::close(fd);
+                    if (result != 0)
+                        fail("cannot sync", directory_);
+                }
+            }
+            catch (...)
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                unsynced_.insert(unsynced_.end(), sealed.begin(), sealed.end());
+                directoryDirty_ = directoryDirty_ || directoryDirty;
+                throw;
+            }
+        }
+
+        // Up to maxRecords records starting at `from` (or at the oldest
+        // record, if `from` is older than that).
+        std::vector<Record> read(std::uint64_t from, std::size_t maxRecords)
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            std::vector<Record> records;
+            auto it = segments_.upper_bound(from);
+            if (it != segments_.begin())
+                --it;
+            for (; it != segments_.end() && records.size() < maxRecords; ++it)
+            {
+                Segment &segment = *it->second;
+                if (from >= segment.nextOffset)
+                    continue;
+                openForRead(segment);
+
+                std::uint64_t offset = segment.baseOffset;
+                std::uint64_t position = 0;
+                seek(segment, std::max(from, segment.baseOffset), offset, position);
+                scan(segment.fd, position, segment.size, [&](std::uint64_t, const char *data, std::uint32_t size) {
+                    if (offset >= from)
+                        records.push_back(Record{offset, std::string(data, size)});
+                    ++offset;
+                    return records.size() < maxRecords;
+                });
+            }
+            return records;
+        }
+
+        // Calls visit(offset, data, size) for every record from `from`
+        // onwards, in order, and returns how many there were. Unlike read(),
+        // each segment holding such records is mapped read-only and walked
+        // in place from the index entry nearest `from`, so nothing before
+        // that is touched and no record is copied; on restart that is
+        // usually just the tail segment. `data` is only valid during the
+        // call, and visit must not call back into the log.
+        template <typename Visit>
+        std::uint64_t replay(std::uint64_t from, Visit &&visit)
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            std::uint64_t visited = 0;
+            auto it = segments_.upper_bound(from);
+            if (it != segments_.begin())
+                --it;
+            for (; it != segments_.end(); ++it)
+            {
+                Segment &segment = *it->second;
+                if (from >= segment.nextOffset)
+                    continue;
+                openForRead(segment);
+
+                std::uint64_t offset = segment.baseOffset;
+                std::uint64_t position = 0;
+                seek(segment, std::max(from, segment.baseOffset), offset, position);
+                if (position >= segment.size)
+                    continue;
+
+                // mmap offsets must be page aligned.
+                std::uint64_t page = static_cast<std::uint64_t>(::sysconf(_SC_PAGESIZE));
+                std::uint64_t mapStart = position - position % page;
+                std::size_t mapBytes = static_cast<std::size_t>(segment.size - mapStart);
+                void *mapped = ::mmap(nullptr, mapBytes, PROT_READ, MAP_PRIVATE, segment.fd, static_cast<off_t>(mapStart));
+                if (mapped == MAP_FAILED)
+                    fail("cannot map", segment.path);
+                ::madvise(mapped, mapBytes, MADV_SEQUENTIAL);
+
+                const char *base = static_cast<const char *>(mapped) - mapStart;
+                while (segment.size - position >= sizeof(RecordHeader))
+                {
+                    RecordHeader header;
+                    std::memcpy(&header, base + position, sizeof(header));
+                    const char *payload = base + position + sizeof(RecordHeader);
+                    if (header.length > segment.size - position - sizeof(RecordHeader) ||
+                        checksum(header.length, payload) != header.crc)
+                        break;
+                    if (offset >= from)
+                    {
+                        visit(offset, payload, header.length);
+                        ++visited;
+                    }
+                    ++offset;
+                    position += sizeof(RecordHeader) + header.length;
+                }
+                ::munmap(mapped, mapBytes);
+            }
+            return visited;
+        }
+
+        std::uint64_t startOffset() const
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            return segments_.begin()->first;
+        }
+
+        // Offset the next append will get.
+        std::uint64_t nextOffset() const
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            return segments_.rbegin()->second->nextOffset;
+        }
+
+        std::size_t segmentCount() const
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            return segments_.size();
+        }
+
+        const std::string &directory() const { return directory_; }
+
+    private:
+        static constexpr std::size_t kReadChunk = 64 * 1024;
+
+        struct RecordHeader
+        {
+            std::uint32_t length;
+            std::uint32_t crc;
+        };
+
+        struct IndexEntry
+        {
+            std::uint32_t relativeOffset;
+            std::uint32_t position;
+        };
+
+        struct Segment
+        {
+            Segment(std::uint64_t base, std::string logPath)
+                : baseOffset(base), nextOffset(base), path(std::move(logPath))
+            {
+                indexPath = path.substr(0, path.size() - 4) + ".index";
+            }
+
+            void closeFiles()
+            {
+                if (fd >= 0)
+                    ::close(fd);
+                if (indexFd >= 0)
+                    ::close(indexFd);
+                fd = -1;
+                indexFd = -1;
+            }
+
+            std::uint64_t baseOffset;
+            std::uint64_t nextOffset; // one past the last record
+            std::uint64_t size = 0;   // bytes of whole, valid records
+            std::uint64_t bytesSinceIndex = 0;
+            std::string path;
+            std::string indexPath;
+            int fd = -1;      // the active segment's is read-write; older ones are opened read-only on demand
+            int indexFd = -1; // only open on the active segment
+            bool indexLoaded = false;
+            std::vector<IndexEntry> index;
+        };
+
+        static std::uint32_t checksum(std::uint32_t length, const char *payload)
+        {
+            return crc32(payload, length, crc32(&length, sizeof(length)));
+        }
+
+        static bool parseBase(const std::string &stem, std::uint64_t &base)
+        {
+            if (stem.size() != 20 || !std::all_of(stem.begin(), stem.end(), [](char c) { return c >= '0' && c <= '9'; }))
+                return false;
+            base = std::stoull(stem);
+            return true;
+        }
+
+        std::string segmentPath(std::uint64_t base, const char *extension) const
+        {
+            char name[32];
+            std::snprintf(name, sizeof(name), "%020llu", static_cast<unsigned long long>(base));
+            return directory_ + "/" + name + extension;
+        }
+
+        static int openFile(const std::string &path, int flags)
+        {
+            int fd = ::open(path.c_str(), flags | O_CLOEXEC, 0644);
+            if (fd < 0)
+                fail("cannot open", path);
+            return fd;
+        }
+
+        static void readAll(int fd, char *data, std::size_t size, std::uint64_t position, const std::string &path)
+        {
+            while (size > 0)
+            {
+                ssize_t got = ::pread(fd, data, size, static_cast<off_t>(position));
+                if (got < 0 && errno == EINTR)
+                    continue;
+                if (got <= 0)
+                    fail("cannot read", path);
+                data += got;
+                size -= static_cast<std::size_t>(got);
+                position += static_cast<std::uint64_t>(got);
+            }
+        }
+
+        // On failure, cuts the segment back to its last whole record before
+        // throwing, so a short write doesn't leave a torn record behind.
+        static void writeAll(int fd, const char *data, std::size_t size, std::uint64_t position, const Segment &segment)
+        {
+            while (size > 0)
+            {
+                ssize_t written = ::pwrite(fd, data, size, static_cast<off_t>(position));
+                if (written < 0 && errno == EINTR)
+                    continue;
+                if (written <= 0)
+                {
+                    int error = errno;
+                    bool truncated = ::ftruncate(segment.fd, static_cast<off_t>(segment.size)) == 0;
+                    (void)truncated;
+                    errno = error;
+                    fail("cannot write", segment.path);
+                }
+                data += written;
+                size -= static_cast<std::size_t>(written);
+                position += static_cast<std::uint64_t>(written);
+            }
+        }
+
+        static std::uint64_t fileSize(int fd, const std::string &path)
+        {
+            struct stat info;
+            if (::fstat(fd, &info) != 0)
+                fail("cannot stat", path);
+            return static_cast<std::uint64_t>(info.st_size);
+        }
+
+        // Walks the records stored in [position, end) of fd, calling
+        // visit(position, payload, length) for each one whose length and CRC
+        // check out, until one doesn't or visit returns false. Returns the
+        // position just past the last record visited.
+        template <typename Visit>
+        static std::uint64_t scan(int fd, std::uint64_t position, std::uint64_t end, Visit &&visit)
+        {
+            std::vector<char> buffer;
+            std::uint64_t bufferStart = position;
+            std::size_t buffered = 0;
+
+            // Makes [at, at + need) resident in buffer.
+            auto fill = [&](std::uint64_t at, std::size_t need) {
+                if (at >= bufferStart && at + need <= bufferStart + buffered)
+                    return true;
+                bufferStart = at;
+                buffered = 0;
+                buffer.resize(std::max(kReadChunk, need));
+                std::size_t want = static_cast<std::size_t>(std::min<std::uint64_t>(buffer.size(), end - at));
+                while (buffered < want)
+                {
+                    ssize_t got = ::pread(fd, buffer.data() + buffered, want - buffered,
+                                          static_cast<off_t>(at + buffered));
+                    if (got < 0 && errno == EINTR)
+                        continue;
+                    if (got <= 0)
+                        break;
+                    buffered += static_cast<std::size_t>(got);
+                }
+                return buffered >= need;
+            };
+
+            while (end - position >= sizeof(RecordHeader))
+            {
+                if (!fill(position, sizeof(RecordHeader)))
+                    break;
+                RecordHeader header;
+                std::memcpy(&header, buffer.data() + (position - bufferStart), sizeof(header));
+                if (header.length > end - position - sizeof(RecordHeader))
+                    break;
+                if (!fill(position, sizeof(RecordHeader) + header.length))
+                    break;
+                const char *payload = buffer.data() + (position - bufferStart) + sizeof(RecordHeader);
+                if (checksum(header.length, payload) != header.crc)
+                    break;
+
+                std::uint64_t at = position;
+                position += sizeof(RecordHeader) + header.length;
+                if (!visit(at, payload, header.length))
+                    break;
+            }
+            return position;
+        }
+
+        Segment &active() { return *segments_.rbegin()->second; }
+
+        // Reads <base>.index, keeping the entries that point inside the
+        // segment's valid bytes; if there is no index file, rebuilds it.
+        void loadIndex(Segment &segment)
+        {
+            if (segment.indexLoaded)
+                return;
+            segment.indexLoaded = true;
+            segment.index.clear();
+
+            int fd = ::open(segment.indexPath.c_str(), O_RDONLY | O_CLOEXEC);
+            if (fd >= 0)
+            {
+                std::uint64_t bytes = fileSize(fd, segment.indexPath);
+                segment.index.resize(static_cast<std::size_t>(bytes / sizeof(IndexEntry)));
+                if (!segment.index.empty())
+                    readAll(fd, reinterpret_cast<char *>(segment.index.data()),
+                            segment.index.size() * sizeof(IndexEntry), 0, segment.indexPath);
+                ::close(fd);
+                while (!segment.index.empty() && segment.index.back().position >= segment.size)
+                    segment.index.pop_back();
+                return;
+            }
+
+            std::uint64_t offset = segment.baseOffset;
+            std::uint64_t sinceEntry = 0;
+            scan(segment.fd, 0, segment.size, [&](std::uint64_t position, const char *, std::uint32_t length) {
+                if (sinceEntry >= options_.indexIntervalBytes)
+                {
+                    segment.index.push_back(IndexEntry{static_cast<std::uint32_t>(offset - segment.baseOffset),
+                                                       static_cast<std::uint32_t>(position)});
+                    sinceEntry = 0;
+                }
+                sinceEntry += sizeof(RecordHeader) + length;
+                ++offset;
+                return true;
+            });
+            rewriteIndex(segment);
+        }
+
+        void rewriteIndex(Segment &segment)
+        {
+            int fd = openFile(segment.indexPath, O_WRONLY | O_CREAT | O_TRUNC);
+            const char *data = reinterpret_cast<const char *>(segment.index.data());
+            std::size_t size = segment.index.size() * sizeof(IndexEntry);
+            while (size > 0)
+            {
+                ssize_t written = ::write(fd, data, size);
+                if (written < 0 && errno == EINTR)
+                    continue;
+                if (written <= 0)
+                {
+                    ::close(fd);
+                    fail("cannot write", segment.indexPath);
+                }
+                data += written;
+                size -= static_cast<std::size_t>(written);
+            }
+            ::close(fd);
+        }
+
+        // Closest index entry at or before `offset`.
+        void seek(Segment &segment, std::uint64_t offset, std::uint64_t &foundOffset, std::uint64_t &position)
+        {
+            loadIndex(segment);
+            std::uint64_t relative = offset - segment.baseOffset;
+            auto entry = std::upper_bound(segment.index.begin(), segment.index.end(), relative,
+                                          [](std::uint64_t wanted, const IndexEntry &e) { return wanted < e.relativeOffset; });
+            if (entry == segment.index.begin())
+            {
+                foundOffset = segment.baseOffset;
+                position = 0;
+                return;
+            }
+            --entry;
+            foundOffset = segment.baseOffset + entry->relativeOffset;
+            position = entry->position;
+        }
+
+        // Opens the newest segment for appending. An existing one is scanned
+        // from its last index entry to find the end of its last whole record;
+        // anything after that (a write cut short by a crash) is truncated.
+        void openActive(Segment &segment, bool fresh)
+        {
+            segment.fd = openFile(segment.path, O_RDWR | O_CREAT);
+            segment.size = fileSize(segment.fd, segment.path);
+            std::uint64_t end = 0;
+            if (fresh)
+                directoryDirty_ = true;
+            if (fresh || segment.size == 0)
+            {
+                segment.indexLoaded = true;
+                segment.index.clear();
+            }
+            else
+            {
+                loadIndex(segment);
+                std::uint64_t offset = segment.baseOffset;
+                std::uint64_t position = 0;
+                if (!segment.index.empty())
+                {
+                    offset += segment.index.back().relativeOffset;
+                    position = segment.index.back().position;
+                }
+                end = scan(segment.fd, position, segment.size, [&](std::uint64_t, const char *, std::uint32_t) {
+                    ++offset;
+                    return true;
+                });
+                segment.nextOffset = offset;
+                segment.bytesSinceIndex = end - (segment.index.empty() ? 0 : segment.index.back().position);
+            }
+
+            if (end != segment.size && ::ftruncate(segment.fd, static_cast<off_t>(end)) != 0)
+                fail("cannot truncate", segment.path);
+            segment.size = end;
+            segment.indexFd = openFile(segment.indexPath, O_WRONLY | O_CREAT);
+            if (::ftruncate(segment.indexFd, static_cast<off_t>(segment.index.size() * sizeof(IndexEntry))) != 0)
+                fail("cannot truncate", segment.indexPath);
+        }
+
+        void openForRead(Segment &segment)
+        {
+            if (segment.fd >= 0)
+                return;
+            segment.fd = openFile(segment.path, O_RDONLY);
+            segment.size = fileSize(segment.fd, segment.path);
+        }
+
+        // Serialises the records into scratch_ and writes them to the active
+        // segment in one go, splitting the run wherever the segment fills up
+        // and a new one has to be started. Index entries for a run are
+        // written only after its records are.
+        std::uint64_t appendRange(const std::string *first, const std::string *last)
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            std::uint64_t firstOffset = active().nextOffset;
+            std::vector<IndexEntry> entries;
+            Segment *segment = &active();
+            std::uint64_t runOffset = segment->nextOffset;
+            std::uint64_t runSinceIndex = segment->bytesSinceIndex;
+            scratch_.clear();
+
+            auto writeRun = [&]() {
+                if (scratch_.empty())
+                    return;
+                try
+                {
+                    writeAll(segment->fd, scratch_.data(), scratch_.size(), segment->size, *segment);
+                }
+                catch (...)
+                {
+                    segment->nextOffset = runOffset;
+                    segment->bytesSinceIndex = runSinceIndex;
+                    throw;
+                }
+                segment->size += scratch_.size();
+                for (const IndexEntry &entry : entries)
+                    addIndexEntry(*segment, entry);
+                entries.clear();
+                scratch_.clear();
+            };
+
+            for (const std::string *payload = first; payload != last; ++payload)
+            {
+                std::uint64_t recordBytes = sizeof(RecordHeader) + payload->size();
+                std::uint64_t position = segment->size + scratch_.size();
+                if (position > 0 && position + recordBytes > options_.maxSegmentBytes)
+                {
+                    writeRun();
+                    roll();
+                    segment = &active();
+                    runOffset = segment->nextOffset;
+                    runSinceIndex = segment->bytesSinceIndex;
+                    position = 0;
+                }
+
+                if (segment->bytesSinceIndex >= options_.indexIntervalBytes)
+                {
+                    entries.push_back(IndexEntry{static_cast<std::uint32_t>(segment->nextOffset - segment->baseOffset),
+                                                 static_cast<std::uint32_t>(position)});
+                    segment->bytesSinceIndex = 0;
+                }
+                RecordHeader header{static_cast<std::uint32_t>(payload->size()), 0};
+                header.crc = checksum(header.length, payload->data());
+                scratch_.append(reinterpret_cast<const char *>(&header), sizeof(header));
+                scratch_.append(*payload);
+                segment->bytesSinceIndex += recordBytes;
+                ++segment->nextOffset;
+            }
+            writeRun();
+            return firstOffset;
+        }
+
+        void addIndexEntry(Segment &segment, const IndexEntry &entry)
+        {
+            off_t at = static_cast<off_t>(segment.index.size() * sizeof(IndexEntry));
+            if (::pwrite(segment.indexFd, &entry, sizeof(entry), at) != static_cast<ssize_t>(sizeof(entry)))
+                fail("cannot write", segment.indexPath);
+            segment.index.push_back(entry);
+        }
+
+
+        // Seals the active segment and starts a new one at the next offset.
+        // The sealed segment keeps its in-memory index and its descriptor,
+        // now used for reads and for the next sync().
+        void roll()
+        {
+            Segment &sealed = active();
+            ::close(sealed.indexFd);
+            sealed.indexFd = -1;
+
+            unsynced_.push_back(&sealed);
+
+            std::uint64_t base = sealed.nextOffset;
+            auto segment = std::make_unique<Segment>(base, segmentPath(base, ".log"));
+            Segment &fresh = *segment;
+            segments_.emplace(base, std::move(segment));
+            openActive(fresh, true);
+        }
+
+        std::string directory_;
+        LogOptions options_;
+        mutable std::mutex mutex_;
+        std::map<std::uint64_t, std::unique_ptr<Segment>> segments_;
+        std::string scratch_;
+        std::vector<Segment *> unsynced_; // sealed since the last sync()
+        bool directoryDirty_ = false;     // a segment was created since the last sync()
+    };
+
+
+    // A consumer's committed offset (the next record it has not finished
+    // with), kept in one small file. commit() writes the new value to
+    // <path>.tmp, fdatasyncs it, renames it over <path> and fsyncs the
+    // directory, so after a crash the file holds either the previous or the
+    // new offset, never a torn one. Each commit costs a few syncs, so
+    // callers batch them. A missing or corrupt file loads as no offset;
+    // corrupt() tells the two apart.
+    class OffsetCheckpoint
+    {
+    public:
+        explicit OffsetCheckpoint(std::string path) : path_(std::move(path))
+        {
+            int fd = ::open(path_.c_str(), O_RDONLY | O_CLOEXEC);
+            if (fd < 0)
+                return;
+            Contents contents;
+            ssize_t got = ::pread(fd, &contents, sizeof(contents), 0);
+            ::close(fd);
+            if (got == static_cast<ssize_t>(sizeof(contents)) && contents.magic == kMagic &&
+                contents.version == kVersion && contents.crc == crcOf(contents))
+                offset_ = contents.offset;
+            else
+                corrupt_ = true;
+        }
+
+        std::optional<std::uint64_t> offset() const { return offset_; }
+        bool corrupt() const { return corrupt_; } // the file existed but could not be read
+        const std::string &path() const { return path_; }
+
+        void commit(std::uint64_t offset)
+        {
+            Contents contents{kMagic, kVersion, 0, offset};
+            contents.crc = crcOf(contents);
+
+            std::string temporary = path_ + ".tmp";
+            int fd = ::open(temporary.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+            if (fd < 0)
+                fail("cannot open", temporary);
+            bool written = ::pwrite(fd, &contents, sizeof(contents), 0) == static_cast<ssize_t>(sizeof(contents)) &&
+                           ::fdatasync(fd) == 0;
+            int error = errno;
+            ::close(fd);
+            errno = error;
+            if (!written)
+                fail("cannot write", temporary);
+            if (::rename(temporary.c_str(), path_.c_str()) != 0)
+                fail("cannot rename", temporary);
+
+            std::string directory = std::filesystem::path(path_).parent_path().string();
+            int directoryFd = ::open(directory.empty() ? "." : directory.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+            if (directoryFd >= 0)
+            {
+                ::fsync(directoryFd);
+                ::close(directoryFd);
+            }
+            offset_ = offset;
+        }
+
+    private:
+        static constexpr std::uint64_t kMagic = 0x54504b43544f4646ULL; // "FFOTCKPT"
+        static constexpr std::uint32_t kVersion = 1;
+
+        struct Contents
+        {
+            std::uint64_t magic;
+            std::uint32_t version;
+            std::uint32_t crc; // of offset
+            std::uint64_t offset;
+        };
+
+        static std::uint32_t crcOf(const Contents &contents) { return crc32(&contents.offset, sizeof(contents.offset)); }
+
+        std::string path_;
+        std::optional<std::uint64_t> offset_;
+        bool corrupt_ = false;
+    };
+
+}
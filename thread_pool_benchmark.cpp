@@ -0,0 +1,314 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <future>
+#include <iostream>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "thread_pool_demo.h"
+
+#define THREAD_POOL_DEMO_NO_MAIN
+#include "thread_pool_demo.cpp"
+
+// Microbenchmark suite for both thread pools:
+//   header_shared_queue   thread_pool_demo::ThreadPool
+//   header_work_stealing  thread_pool_demo::WorkStealingThreadPool
+//   future_enqueue        ThreadPool::enqueue (std::future per task)
+//   future_submit         ThreadPool::submit (allocation-free path)
+//
+// For every pool, thread count and workload (empty, tiny, heavy task bodies,
+// plus a fan-out workload for the header pools) it reports how fast one
+// producer can enqueue, end-to-end throughput and enqueue-to-finish latency
+// percentiles. Output is CSV by default or JSON with --format=json, one row
+// per configuration, so runs can be diffed when the scheduler changes.
+//
+// Usage: thread_pool_benchmark [--format=csv|json] [--quick]
+
+namespace
+{
+    using Clock = std::chrono::steady_clock;
+
+    enum class Workload
+    {
+        Empty,
+        Tiny,
+        Heavy,
+        FanOut
+    };
+
+    const char *workloadName(Workload workload)
+    {
+        switch (workload)
+        {
+        case Workload::Empty:
+            return "empty";
+        case Workload::Tiny:
+            return "tiny";
+        case Workload::Heavy:
+            return "heavy";
+        case Workload::FanOut:
+            return "fanout";
+        }
+        return "unknown";
+    }
+
+    void spin(int iterations)
+    {
+        volatile int sink = 0;
+        for (int i = 0; i < iterations; ++i)
+            sink = sink + i;
+    }
+
+    void runBody(Workload workload)
+    {
+        if (workload == Workload::Tiny)
+            spin(100);
+        else if (workload == Workload::Heavy)
+            spin(50000);
+    }
+
+    struct Result
+    {
+        std::string pool;
+        size_t threads = 0;
+        Workload workload = Workload::Empty;
+        int tasks = 0;
+        double enqueuePerSec = 0;
+        double throughputPerSec = 0;
+        // Latency percentiles are only meaningful when every task is
+        // submitted by the measuring thread (not for fan-out).
+        std::optional<double> p50Us;
+        std::optional<double> p99Us;
+        std::optional<double> maxUs;
+    };
+
+    // Shared by every task of one run; tasks capture a pointer to it so the
+    // queued callable stays small enough for InlineTask's inline buffer.
+    struct RunContext
+    {
+        Workload workload;
+        int total;
+        std::vector<std::int64_t> latencyNanos;
+        std::atomic<int> completed{0};
+        std::promise<void> done;
+
+        void finish(int index, Clock::time_point enqueuedAt)
+        {
+            runBody(workload);
+            latencyNanos[index] = std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - enqueuedAt).count();
+            if (completed.fetch_add(1) + 1 == total)
+                done.set_value();
+        }
+    };
+
+    double percentileUs(std::vector<std::int64_t> &sorted, double p)
+    {
+        size_t rank = static_cast<size_t>(p / 100.0 * (sorted.size() - 1));
+        return sorted[rank] / 1000.0;
+    }
+
+    // Submit adapters: every pool gets the same fire-and-forget call shape.
+    template <typename Task>
+    void post(thread_pool_demo::ThreadPool &pool, Task &&task) { pool.enqueue(std::forward<Task>(task)); }
+
+    template <typename Task>
+    void post(thread_pool_demo::WorkStealingThreadPool &pool, Task &&task) { pool.enqueue(std::forward<Task>(task)); }
+
+    struct FutureEnqueue
+    {
+        ::ThreadPool pool;
+        explicit FutureEnqueue(size_t threads) : pool(threads) {}
+    };
+
+    struct FutureSubmit
+    {
+        ::ThreadPool pool;
+        explicit FutureSubmit(size_t threads) : pool(threads) {}
+    };
+
+    template <typename Task>
+    void post(FutureEnqueue &wrapper, Task &&task) { wrapper.pool.enqueue(std::forward<Task>(task)); }
+
+    template <typename Task>
+    void post(FutureSubmit &wrapper, Task &&task) { wrapper.pool.submit(std::forward<Task>(task)); }
+
+    template <typename Pool>
+    Result runFlat(const char *name, size_t threads, Workload workload, int tasks)
+    {
+        RunContext context;
+        context.workload = workload;
+        context.total = tasks;
+        context.latencyNanos.assign(tasks, 0);
+        std::future<void> finished = context.done.get_future();
+
+        Result result;
+        result.pool = name;
+        result.threads = threads;
+        result.workload = workload;
+        result.tasks = tasks;
+
+        {
+            Pool pool(threads);
+
+            Clock::time_point start = Clock::now();
+            for (int i = 0; i < tasks; ++i)
+            {
+                RunContext *shared = &context;
+                Clock::time_point enqueuedAt = Clock::now();
+                post(pool, [shared, i, enqueuedAt]()
+                     { shared->finish(i, enqueuedAt); });
+            }
+            Clock::time_point enqueued = Clock::now();
+            finished.wait();
+            Clock::time_point end = Clock::now();
+
+            result.enqueuePerSec = tasks / std::chrono::duration<double>(enqueued - start).count();
+            result.throughputPerSec = tasks / std::chrono::duration<double>(end - start).count();
+        }
+
+        std::sort(context.latencyNanos.begin(), context.latencyNanos.end());
+        result.p50Us = percentileUs(context.latencyNanos, 50);
+        result.p99Us = percentileUs(context.latencyNanos, 99);
+        result.maxUs = context.latencyNanos.back() / 1000.0;
+        return result;
+    }
+
+    // Every root task submits a batch of children from inside the pool, which
+    // is where per-worker deques pay off.
+    template <typename Pool>
+    Result runFanOut(const char *name, size_t threads, int roots)
+    {
+        const int childrenPerRoot = 32;
+        const int total = roots * (childrenPerRoot + 1);
+
+        std::atomic<int> completed(0);
+        std::promise<void> done;
+        std::future<void> finished = done.get_future();
+
+        auto finishOne = [&completed, &done, total]()
+        {
+            if (completed.fetch_add(1) + 1 == total)
+                done.set_value();
+        };
+
+        Result result;
+        result.pool = name;
+        result.threads = threads;
+        result.workload = Workload::FanOut;
+        result.tasks = total;
+
+        {
+            Pool pool(threads);
+
+            Clock::time_point start = Clock::now();
+            for (int root = 0; root < roots; ++root)
+            {
+                pool.enqueue([&pool, &finishOne, childrenPerRoot]()
+                             {
+                    for (int child = 0; child < childrenPerRoot; ++child)
+                    {
+                        pool.enqueue([&finishOne]()
+                                     {
+                            spin(200);
+                            finishOne(); });
+                    }
+                    finishOne(); });
+            }
+            Clock::time_point enqueued = Clock::now();
+            finished.wait();
+            Clock::time_point end = Clock::now();
+
+            result.enqueuePerSec = roots / std::chrono::duration<double>(enqueued - start).count();
+            result.throughputPerSec = total / std::chrono::duration<double>(end - start).count();
+        }
+        return result;
+    }
+
+    void printCsv(const std::vector<Result> &results)
+    {
+        std::cout << "pool,threads,workload,tasks,enqueue_per_sec,throughput_per_sec,p50_us,p99_us,max_us" << std::endl;
+        for (const Result &result : results)
+        {
+            std::cout << result.pool << "," << result.threads << "," << workloadName(result.workload) << ","
+                      << result.tasks << "," << result.enqueuePerSec << "," << result.throughputPerSec;
+            for (const std::optional<double> &value : {result.p50Us, result.p99Us, result.maxUs})
+            {
+                std::cout << ",";
+                if (value)
+                    std::cout << *value;
+            }
+            std::cout << std::endl;
+        }
+    }
+
+    void printJson(const std::vector<Result> &results)
+    {
+        auto field = [](const std::optional<double> &value)
+        {
+            return value ? std::to_string(*value) : std::string("null");
+        };
+
+        std::cout << "[" << std::endl;
+        for (size_t i = 0; i < results.size(); ++i)
+        {
+            const Result &result = results[i];
+            std::cout << "  {\"pool\": \"" << result.pool << "\", \"threads\": " << result.threads
+                      << ", \"workload\": \"" << workloadName(result.workload) << "\", \"tasks\": " << result.tasks
+                      << ", \"enqueue_per_sec\": " << std::to_string(result.enqueuePerSec)
+                      << ", \"throughput_per_sec\": " << std::to_string(result.throughputPerSec)
+                      << ", \"p50_us\": " << field(result.p50Us) << ", \"p99_us\": " << field(result.p99Us)
+                      << ", \"max_us\": " << field(result.maxUs) << "}"
+                      << (i + 1 < results.size() ? "," : "") << std::endl;
+        }
+        std::cout << "]" << std::endl;
+    }
+}
+
+int main(int argc, char **argv)
+{
+    bool json = false;
+    bool quick = false;
+    for (int i = 1; i < argc; ++i)
+    {
+        if (std::strcmp(argv[i], "--format=json") == 0)
+            json = true;
+        else if (std::strcmp(argv[i], "--format=csv") == 0)
+            json = false;
+        else if (std::strcmp(argv[i], "--quick") == 0)
+            quick = true;
+        else
+        {
+            std::cerr << "usage: " << argv[0] << " [--format=csv|json] [--quick]" << std::endl;
+            return 1;
+        }
+    }
+
+    const std::vector<size_t> threadCounts = {1, 4, 16, 64};
+    const int scale = quick ? 10 : 1;
+
+    std::vector<Result> results;
+    for (size_t threads : threadCounts)
+    {
+        for (Workload workload : {Workload::Empty, Workload::Tiny, Workload::Heavy})
+        {
+            int tasks = (workload == Workload::Heavy ? 2000 : 50000) / scale;
+            results.push_back(runFlat<thread_pool_demo::ThreadPool>("header_shared_queue", threads, workload, tasks));
+            results.push_back(runFlat<thread_pool_demo::WorkStealingThreadPool>("header_work_stealing", threads, workload, tasks));
+            results.push_back(runFlat<FutureEnqueue>("future_enqueue", threads, workload, tasks));
+            results.push_back(runFlat<FutureSubmit>("future_submit", threads, workload, tasks));
+        }
+
+        results.push_back(runFanOut<thread_pool_demo::ThreadPool>("header_shared_queue", threads, 2000 / scale));
+        results.push_back(runFanOut<thread_pool_demo::WorkStealingThreadPool>("header_work_stealing", threads, 2000 / scale));
+    }
+
+    if (json)
+        printJson(results);
+    else
+        printCsv(results);
+
+    return 0;
+}
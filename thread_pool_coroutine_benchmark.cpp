@@ -0,0 +1,195 @@
+#define THREAD_POOL_DEMO_NO_MAIN
+#include "thread_pool_demo.cpp"
+
+#include <queue>
+
+// Simulated downstream calls: 100k operations each wait 10ms on "I/O" using a
+// 4-worker ThreadPool. Coroutine handlers suspend while waiting, so every
+// operation can be in flight at once; blocking handlers pin a worker per
+// operation and are capped at the worker count.
+//
+// Build with -std=c++20.
+
+namespace
+{
+    using Clock = std::chrono::steady_clock;
+
+    // Single timer thread standing in for an event loop / I/O completion port.
+    class DelayService
+    {
+    public:
+        DelayService() : stop(false), timer([this]
+                                            { run(); }) {}
+
+        ~DelayService()
+        {
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                stop = true;
+            }
+            condition.notify_one();
+            timer.join();
+        }
+
+        void after(std::chrono::microseconds delay, std::function<void()> callback)
+        {
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                timers.push(Timer{Clock::now() + delay, std::move(callback)});
+            }
+            condition.notify_one();
+        }
+
+    private:
+        struct Timer
+        {
+            Clock::time_point due;
+            std::function<void()> callback;
+
+            bool operator>(const Timer &other) const { return due > other.due; }
+        };
+
+        void run()
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            while (!stop)
+            {
+                if (timers.empty())
+                {
+                    condition.wait(lock);
+                    continue;
+                }
+
+                Clock::time_point due = timers.top().due;
+                if (Clock::now() < due)
+                {
+                    condition.wait_until(lock, due);
+                    continue;
+                }
+
+                std::function<void()> callback = std::move(const_cast<Timer &>(timers.top()).callback);
+                timers.pop();
+                lock.unlock();
+                callback();
+                lock.lock();
+            }
+        }
+
+        std::mutex mutex;
+        std::condition_variable condition;
+        std::priority_queue<Timer, std::vector<Timer>, std::greater<Timer>> timers;
+        bool stop;
+        std::thread timer;
+    };
+
+    struct InFlight
+    {
+        std::atomic<int> current{0};
+        std::atomic<int> peak{0};
+
+        void enter()
+        {
+            int now = current.fetch_add(1) + 1;
+            int seen = peak.load();
+            while (now > seen && !peak.compare_exchange_weak(seen, now))
+            {
+            }
+        }
+
+        void leave() { current.fetch_sub(1); }
+    };
+
+    // Suspends the coroutine for `delay` and resumes it on the pool.
+    auto sleepOnPool(ThreadPool &pool, DelayService &io, std::chrono::microseconds delay)
+    {
+        struct SleepAwaiter
+        {
+            ThreadPool &pool;
+            DelayService &io;
+            std::chrono::microseconds delay;
+
+            bool await_ready() const noexcept { return false; }
+            void await_suspend(std::coroutine_handle<> handle)
+            {
+                io.after(delay, [&pool = pool, handle]()
+                         { pool.resume(handle); });
+            }
+            void await_resume() const noexcept {}
+        };
+
+        return SleepAwaiter{pool, io, delay};
+    }
+
+    Task<int> coroutineHandler(ThreadPool &pool, DelayService &io, InFlight &inFlight)
+    {
+        co_await pool.schedule();
+        inFlight.enter();
+        co_await sleepOnPool(pool, io, std::chrono::milliseconds(10));
+        inFlight.leave();
+        co_return 1;
+    }
+
+    int blockingHandler(DelayService &io, InFlight &inFlight)
+    {
+        inFlight.enter();
+        std::promise<void> done;
+        std::future<void> ready = done.get_future();
+        io.after(std::chrono::milliseconds(10), [&done]()
+                 { done.set_value(); });
+        ready.get();
+        inFlight.leave();
+        return 1;
+    }
+
+    void report(const char *mode, int operations, const InFlight &inFlight, Clock::duration elapsed)
+    {
+        double seconds = std::chrono::duration<double>(elapsed).count();
+        std::cout << mode << "\t" << operations << "\t" << inFlight.peak.load() << "\t"
+                  << seconds * 1000.0 << "\t" << operations / seconds << std::endl;
+    }
+}
+
+int main()
+{
+    const size_t workers = 4;
+
+    std::cout << "mode\toperations\tpeak_in_flight\telapsed_ms\tops_per_sec" << std::endl;
+
+    {
+        const int operations = 100000;
+        ThreadPool pool(workers);
+        // Declared after the pool so the timer thread, which resumes
+        // coroutines onto the pool, is joined before the pool goes away.
+        DelayService io;
+        InFlight inFlight;
+
+        auto start = Clock::now();
+        std::vector<Task<int>> handlers;
+        handlers.reserve(operations);
+        for (int i = 0; i < operations; ++i)
+            handlers.push_back(coroutineHandler(pool, io, inFlight));
+
+        std::vector<int> results = syncWait(when_all(std::move(handlers)));
+        report("coroutine", static_cast<int>(results.size()), inFlight, Clock::now() - start);
+    }
+
+    {
+        // Far fewer operations: at one worker per wait this already takes
+        // operations / workers * 10ms.
+        const int operations = 400;
+        ThreadPool pool(workers);
+        DelayService io;
+        InFlight inFlight;
+
+        auto start = Clock::now();
+        std::vector<std::future<int>> results;
+        results.reserve(operations);
+        for (int i = 0; i < operations; ++i)
+            results.push_back(pool.enqueue(blockingHandler, std::ref(io), std::ref(inFlight)));
+        for (auto &result : results)
+            result.get();
+        report("blocking_future", operations, inFlight, Clock::now() - start);
+    }
+
+    return 0;
+}
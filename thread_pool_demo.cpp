@@ -1,15 +1,31 @@
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
 #include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <exception>
 #include <functional>
 #include <future>
 #include <iostream>
 #include <memory>
 #include <mutex>
-#include <queue>
+#include <new>
+#include <optional>
+#include <stdexcept>
 #include <string>
 #include <thread>
+#include <tuple>
 #include <type_traits>
+#include <utility>
 #include <vector>
 
+#if defined(__cpp_impl_coroutine)
+#include <coroutine>
+#endif
+
 template <typename... Args>
 struct ContainsStringArgs;
 
@@ -27,30 +43,565 @@ struct ContainsStringArgs<>
     static constexpr bool value = false;
 };
 
+// Move-only type-erased task with inline small-buffer storage. Callables that
+// fit in kInlineSize bytes are constructed in place, so wrapping them never
+// touches the heap; larger callables fall back to a single heap allocation.
+class InlineTask
+{
+public:
+    static constexpr std::size_t kInlineSize = 64;
+
+    template <typename Fn>
+    static constexpr bool fitsInline = sizeof(Fn) <= kInlineSize &&
+                                       alignof(Fn) <= alignof(std::max_align_t) &&
+                                       std::is_nothrow_move_constructible_v<Fn>;
+
+    InlineTask() noexcept = default;
+
+    template <typename Func, typename = std::enable_if_t<!std::is_same_v<std::decay_t<Func>, InlineTask>>>
+    InlineTask(Func &&func)
+    {
+        using Fn = std::decay_t<Func>;
+        if constexpr (fitsInline<Fn>)
+        {
+            new (storage) Fn(std::forward<Func>(func));
+            ops = &inlineOps<Fn>;
+        }
+        else
+        {
+            *reinterpret_cast<Fn **>(storage) = new Fn(std::forward<Func>(func));
+            ops = &heapOps<Fn>;
+        }
+    }
+
+    InlineTask(InlineTask &&other) noexcept : ops(other.ops)
+    {
+        if (ops)
+        {
+            ops->move(other.storage, storage);
+            other.ops = nullptr;
+        }
+    }
+
+    InlineTask &operator=(InlineTask &&other) noexcept
+    {
+        if (this != &other)
+        {
+            reset();
+            ops = other.ops;
+            if (ops)
+            {
+                ops->move(other.storage, storage);
+                other.ops = nullptr;
+            }
+        }
+        return *this;
+    }
+
+    InlineTask(const InlineTask &) = delete;
+    InlineTask &operator=(const InlineTask &) = delete;
+
+    ~InlineTask() { reset(); }
+
+    void operator()() { ops->invoke(storage); }
+
+    explicit operator bool() const noexcept { return ops != nullptr; }
+
+private:
+    struct Ops
+    {
+        void (*invoke)(void *);
+        void (*move)(void *from, void *to);
+        void (*destroy)(void *);
+    };
+
+    template <typename Fn>
+    static inline const Ops inlineOps = {
+        [](void *self)
+        { (*static_cast<Fn *>(self))(); },
+        [](void *from, void *to)
+        {
+            new (to) Fn(std::move(*static_cast<Fn *>(from)));
+            static_cast<Fn *>(from)->~Fn();
+        },
+        [](void *self)
+        { static_cast<Fn *>(self)->~Fn(); }};
+
+    template <typename Fn>
+    static inline const Ops heapOps = {
+        [](void *self)
+        { (**static_cast<Fn **>(self))(); },
+        [](void *from, void *to)
+        { *static_cast<Fn **>(to) = *static_cast<Fn **>(from); },
+        [](void *self)
+        { delete *static_cast<Fn **>(self); }};
+
+    void reset() noexcept
+    {
+        if (ops)
+        {
+            ops->destroy(storage);
+            ops = nullptr;
+        }
+    }
+
+    alignas(std::max_align_t) unsigned char storage[kInlineSize];
+    const Ops *ops = nullptr;
+};
+
+using TaskClock = std::chrono::steady_clock;
+
+// A queued task plus the scheduling metadata the workers need: when it was
+// queued (for wait-time histograms) and the time by which it should start.
+struct QueuedTask
+{
+    InlineTask task;
+    TaskClock::time_point enqueuedAt;
+    TaskClock::time_point dueBy;
+};
+
+// FIFO ring of QueuedTasks. Capacity only grows (doubling) while the pool
+// warms up; once it has seen its peak backlog push/pop never allocate.
+class TaskRing
+{
+public:
+    void push(QueuedTask &&task)
+    {
+        if (count == slots.size())
+            grow();
+
+        slots[(head + count) % slots.size()] = std::move(task);
+        ++count;
+    }
+
+    const QueuedTask &front() const { return slots[head]; }
+
+    QueuedTask pop()
+    {
+        QueuedTask task = std::move(slots[head]);
+        head = (head + 1) % slots.size();
+        --count;
+        return task;
+    }
+
+    bool empty() const { return count == 0; }
+    std::size_t size() const { return count; }
+
+private:
+    void grow()
+    {
+        std::vector<QueuedTask> bigger(slots.empty() ? 64 : slots.size() * 2);
+        for (std::size_t i = 0; i < count; ++i)
+            bigger[i] = std::move(slots[(head + i) % slots.size()]);
+
+        slots = std::move(bigger);
+        head = 0;
+    }
+
+    std::vector<QueuedTask> slots;
+    std::size_t head = 0;
+    std::size_t count = 0;
+};
+
+// Promise/future shared state that is recycled through a per-type free list
+// instead of being heap allocated for every task (as std::packaged_task does).
+template <typename T>
+class ResultSlotPool;
+
+template <typename T>
+class ResultSlot
+{
+public:
+    void setValue(T &&value)
+    {
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            result.emplace(std::move(value));
+            ready = true;
+        }
+        condition.notify_all();
+    }
+
+    void setException(std::exception_ptr exception)
+    {
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            error = exception;
+            ready = true;
+        }
+        condition.notify_all();
+    }
+
+    void wait()
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        condition.wait(lock, [this]
+                       { return ready; });
+    }
+
+    bool isReady()
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        return ready;
+    }
+
+    T take()
+    {
+        wait();
+        if (error)
+            std::rethrow_exception(error);
+        return std::move(*result);
+    }
+
+    // Called once by the producing side and once by the consuming side; the
+    // last one to let go hands the slot back to the pool.
+    void release()
+    {
+        if (refs.fetch_sub(1, std::memory_order_acq_rel) == 1)
+            ResultSlotPool<T>::instance().recycle(this);
+    }
+
+private:
+    friend class ResultSlotPool<T>;
+
+    std::mutex mutex;
+    std::condition_variable condition;
+    bool ready = false;
+    std::optional<T> result;
+    std::exception_ptr error;
+
+    std::atomic<int> refs{0};
+    ResultSlot *nextFree = nullptr;
+};
+
+template <typename T>
+class ResultSlotPool
+{
+public:
+    static ResultSlotPool &instance()
+    {
+        static ResultSlotPool pool;
+        return pool;
+    }
+
+    ResultSlot<T> *acquire()
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+
+        ResultSlot<T> *slot = freeList;
+        if (slot)
+        {
+            freeList = slot->nextFree;
+        }
+        else
+        {
+            owned.push_back(std::make_unique<ResultSlot<T>>());
+            slot = owned.back().get();
+        }
+
+        slot->refs.store(2, std::memory_order_relaxed);
+        return slot;
+    }
+
+    void recycle(ResultSlot<T> *slot)
+    {
+        slot->ready = false;
+        slot->result.reset();
+        slot->error = nullptr;
+
+        std::unique_lock<std::mutex> lock(mutex);
+        slot->nextFree = freeList;
+        freeList = slot;
+    }
+
+private:
+    std::mutex mutex;
+    ResultSlot<T> *freeList = nullptr;
+    std::vector<std::unique_ptr<ResultSlot<T>>> owned;
+};
+
+// Producer side of a recycled slot; reports broken_promise if the task is
+// destroyed without ever running.
+template <typename T>
+class PooledPromise
+{
+public:
+    explicit PooledPromise(ResultSlot<T> *slot) : slot(slot) {}
+
+    PooledPromise(PooledPromise &&other) noexcept : slot(std::exchange(other.slot, nullptr)) {}
+    PooledPromise &operator=(PooledPromise &&) = delete;
+
+    ~PooledPromise()
+    {
+        if (slot)
+        {
+            slot->setException(std::make_exception_ptr(std::future_error(std::future_errc::broken_promise)));
+            slot->release();
+        }
+    }
+
+    void setValue(T &&value)
+    {
+        slot->setValue(std::move(value));
+        std::exchange(slot, nullptr)->release();
+    }
+
+    void setException(std::exception_ptr exception)
+    {
+        slot->setException(exception);
+        std::exchange(slot, nullptr)->release();
+    }
+
+private:
+    ResultSlot<T> *slot;
+};
+
+// Consumer side of a recycled slot, with the subset of std::future used here.
+template <typename T>
+class PooledFuture
+{
+public:
+    PooledFuture() = default;
+    explicit PooledFuture(ResultSlot<T> *slot) : slot(slot) {}
+
+    PooledFuture(PooledFuture &&other) noexcept : slot(std::exchange(other.slot, nullptr)) {}
+    PooledFuture &operator=(PooledFuture &&other) noexcept
+    {
+        if (this != &other)
+        {
+            reset();
+            slot = std::exchange(other.slot, nullptr);
+        }
+        return *this;
+    }
+
+    ~PooledFuture() { reset(); }
+
+    bool valid() const { return slot != nullptr; }
+
+    void wait() const { slot->wait(); }
+
+    T get()
+    {
+        ResultSlot<T> *current = std::exchange(slot, nullptr);
+        try
+        {
+            T value = current->take();
+            current->release();
+            return value;
+        }
+        catch (...)
+        {
+            current->release();
+            throw;
+        }
+    }
+
+private:
+    void reset()
+    {
+        if (slot)
+            std::exchange(slot, nullptr)->release();
+    }
+
+    ResultSlot<T> *slot = nullptr;
+};
+
+// Void tasks report an int (0) so callers always have something to get().
+template <typename Func, typename... Args>
+using TaskResult = std::conditional_t<
+    std::is_same_v<void, std::invoke_result_t<Func, Args...>>, int,
+    std::invoke_result_t<Func, Args...>>;
+
+template <typename Return, typename Func, typename Tuple>
+Return invokeTask(Func &func, Tuple &args)
+{
+    if constexpr (std::is_void_v<decltype(std::apply(func, args))>)
+    {
+        std::apply(func, args);
+        return Return();
+    }
+    else
+    {
+        return std::apply(func, args);
+    }
+}
+
+// Scheduling lanes, most urgent first.
+enum class TaskPriority
+{
+    High,
+    Normal,
+    Background
+};
+
+constexpr std::size_t kPriorityLanes = 3;
+
+struct TaskOptions
+{
+    TaskPriority priority = TaskPriority::Normal;
+    // Latest acceptable start time. A task that is still queued past its
+    // deadline is not run; its future reports DeadlineExceeded instead.
+    std::optional<TaskClock::time_point> deadline;
+};
+
+class DeadlineExceeded : public std::runtime_error
+{
+public:
+    DeadlineExceeded() : std::runtime_error("Task deadline exceeded before it started.") {}
+};
+
+constexpr std::size_t kHistogramBuckets = 32;
+
+// Point-in-time copy of a LatencyHistogram. Snapshots from several workers
+// can be merged with += before asking for percentiles.
+struct HistogramSnapshot
+{
+    std::array<std::uint64_t, kHistogramBuckets> buckets{};
+
+    HistogramSnapshot &operator+=(const HistogramSnapshot &other)
+    {
+        for (std::size_t i = 0; i < kHistogramBuckets; ++i)
+            buckets[i] += other.buckets[i];
+        return *this;
+    }
+
+    std::uint64_t count() const
+    {
+        std::uint64_t total = 0;
+        for (std::uint64_t bucket : buckets)
+            total += bucket;
+        return total;
+    }
+
+    // Upper bound of the bucket containing the given percentile (0-100).
+    std::chrono::microseconds percentile(double p) const
+    {
+        std::uint64_t total = count();
+        if (total == 0)
+            return std::chrono::microseconds(0);
+
+        std::uint64_t rank = static_cast<std::uint64_t>(p / 100.0 * (total - 1)) + 1;
+        std::uint64_t seen = 0;
+        for (std::size_t i = 0; i < kHistogramBuckets; ++i)
+        {
+            seen += buckets[i];
+            if (seen >= rank)
+                return std::chrono::microseconds(1LL << i);
+        }
+        return std::chrono::microseconds(1LL << (kHistogramBuckets - 1));
+    }
+};
+
+// Log2-bucketed latency histogram (bucket i holds samples below 2^i us).
+// Recording is a single relaxed atomic increment, so workers can update it
+// outside of any lock.
+class LatencyHistogram
+{
+public:
+    static constexpr std::size_t kBuckets = kHistogramBuckets;
+
+    void record(std::chrono::nanoseconds latency)
+    {
+        auto micros = std::chrono::duration_cast<std::chrono::microseconds>(latency).count();
+        std::size_t bucket = 0;
+        while (bucket + 1 < kBuckets && (1LL << bucket) <= micros)
+            ++bucket;
+        buckets[bucket].fetch_add(1, std::memory_order_relaxed);
+    }
+
+    void reset()
+    {
+        for (auto &bucket : buckets)
+            bucket.store(0, std::memory_order_relaxed);
+    }
+
+    HistogramSnapshot snapshot() const
+    {
+        HistogramSnapshot copy;
+        for (std::size_t i = 0; i < kBuckets; ++i)
+            copy.buckets[i] = buckets[i].load(std::memory_order_relaxed);
+        return copy;
+    }
+
+private:
+    std::array<std::atomic<std::uint64_t>, kBuckets> buckets{};
+};
+
+// Counters owned by a single worker. Only that worker writes them (relaxed
+// atomics, no locks); the padding keeps neighbouring workers' counters off
+// the same cache line.
+struct alignas(64) WorkerStats
+{
+    std::atomic<std::uint64_t> tasksRun{0};
+    std::atomic<std::uint64_t> busyNanos{0};
+    std::atomic<std::uint64_t> idleNanos{0};
+    std::array<LatencyHistogram, kPriorityLanes> queueWait;
+    LatencyHistogram runTime;
+};
+
+struct WorkerSnapshot
+{
+    std::uint64_t tasksRun = 0;
+    std::chrono::nanoseconds busyTime{0};
+    std::chrono::nanoseconds idleTime{0};
+    HistogramSnapshot runTime;
+};
+
+struct PoolSnapshot
+{
+    std::array<std::size_t, kPriorityLanes> queueDepth{};
+    std::array<HistogramSnapshot, kPriorityLanes> queueWait;
+    HistogramSnapshot runTime;
+    std::uint64_t tasksRun = 0;
+    int stringTasks = 0;
+    std::vector<WorkerSnapshot> workers;
+};
+
+inline bool deadlinePassed(const std::optional<TaskClock::time_point> &deadline)
+{
+    return deadline && TaskClock::now() > *deadline;
+}
+
 class ThreadPool
 {
 public:
-    explicit ThreadPool(size_t numThreads) : stop(false), stringTasksCounter(0)
+    explicit ThreadPool(size_t numThreads)
+        : workerCount(numThreads), workerStats(std::make_unique<WorkerStats[]>(numThreads)),
+          stringTasksCounter(0), stop(false)
     {
         for (size_t i = 0; i < numThreads; ++i)
         {
-            threads.emplace_back([this]
+            threads.emplace_back([this, &stats = workerStats[i]]
                                  {
         while (true) {
-          std::function<void()> task;
+          QueuedTask next;
+          std::size_t lane;
+          TaskClock::time_point idleSince = TaskClock::now();
 
           {
             std::unique_lock<std::mutex> lock(queueMutex);
-            condition.wait(lock, [this] { return stop || !taskQueue.empty(); });
+            condition.wait(lock, [this] { return stop || queuedTasks != 0; });
 
-            if (stop && taskQueue.empty())
+            if (stop && queuedTasks == 0)
               return;
 
-            task = std::move(taskQueue.front());
-            taskQueue.pop();
+            lane = pickLane();
+            next = lanes[lane].pop();
+            --queuedTasks;
+            laneDepth[lane].store(lanes[lane].size(), std::memory_order_relaxed);
           }
 
-          task();
+          TaskClock::time_point started = TaskClock::now();
+          stats.idleNanos.fetch_add(nanosBetween(idleSince, started), std::memory_order_relaxed);
+          stats.queueWait[lane].record(started - next.enqueuedAt);
+
+          next.task();
+
+          TaskClock::time_point finished = TaskClock::now();
+          stats.runTime.record(finished - started);
+          stats.busyNanos.fetch_add(nanosBetween(started, finished), std::memory_order_relaxed);
+          stats.tasksRun.fetch_add(1, std::memory_order_relaxed);
         } });
         }
     }
@@ -101,17 +652,25 @@ public:
     //   }
 
     template <typename Func, typename... Args>
-    auto enqueue(Func &&func, Args &&...args) -> std::future<std::conditional_t<
-        std::is_same_v<void, std::invoke_result_t<Func, Args...>>, int,
-        std::invoke_result_t<Func, Args...>>>
+    auto enqueue(Func &&func, Args &&...args) -> std::future<TaskResult<Func, Args...>>
+    {
+        return enqueueWith(TaskOptions{}, std::forward<Func>(func), std::forward<Args>(args)...);
+    }
+
+    template <typename Func, typename... Args>
+    auto enqueueWith(const TaskOptions &options, Func &&func, Args &&...args) -> std::future<TaskResult<Func, Args...>>
 
     {
-        using return_type = std::conditional_t<
-            std::is_same_v<void, std::invoke_result_t<Func, Args...>>, int,
-            std::invoke_result_t<Func, Args...>>;
+        using return_type = TaskResult<Func, Args...>;
 
         auto task = std::make_shared<std::packaged_task<return_type()>>(
-            std::bind(std::forward<Func>(func), std::forward<Args>(args)...));
+            [deadline = options.deadline, func = std::forward<Func>(func),
+             args = std::make_tuple(std::forward<Args>(args)...)]() mutable
+            {
+                if (deadlinePassed(deadline))
+                    throw DeadlineExceeded();
+                return invokeTask<return_type>(func, args);
+            });
 
         std::future<return_type> result = task->get_future();
 
@@ -121,63 +680,726 @@ public:
         }
 
 
-        {
-            std::unique_lock<std::mutex> lock(queueMutex);
-            taskQueue.emplace(
-                [task, this, args = std::make_tuple(std::forward<Args>(args)...)]()
+        push(options,
+                [task, this]()
                 {
                     if constexpr (ContainsStringArgs<Args...>::value)
                     {
-                        std::unique_lock<std::mutex> counterLock(counterMutex);
-                        ++stringTasksCounter;
+                        stringTasksCounter.fetch_add(1, std::memory_order_relaxed);
 
                         std::cout << "Enqueued a task that contains a string argument."
                                   << std::endl;
                     }
 
-                    std::apply([&task]()
-                               { (*task)(); },
-                               args);
+                    (*task)();
                 });
-        }
-
-        condition.notify_one();
 
         return result;
     }
 
-    int getStringTasksCounter()
+    // Allocation-free counterpart of enqueue(): the callable and its arguments
+    // are stored inline in the queued InlineTask and the result travels through
+    // a recycled ResultSlot, so steady-state submission never calls malloc.
+    template <typename Func, typename... Args>
+    PooledFuture<TaskResult<Func, Args...>> submit(Func &&func, Args &&...args)
     {
-        std::unique_lock<std::mutex> lock(counterMutex);
-        return stringTasksCounter;
+        return submitWith(TaskOptions{}, std::forward<Func>(func), std::forward<Args>(args)...);
     }
 
-private:
-    std::vector<std::thread> threads;
-    std::queue<std::function<void()>> taskQueue;
+    template <typename Func, typename... Args>
+    PooledFuture<TaskResult<Func, Args...>> submitWith(const TaskOptions &options, Func &&func, Args &&...args)
+    {
+        using return_type = TaskResult<Func, Args...>;
 
-    std::mutex queueMutex;
-    std::condition_variable condition;
-    std::mutex counterMutex;
-    int stringTasksCounter;
-    bool stop;
-};
+        ResultSlot<return_type> *slot = ResultSlotPool<return_type>::instance().acquire();
+        PooledFuture<return_type> result(slot);
 
-// Example usage
-template <typename Return, typename... Args>
-Return printNumber(Args &&...args)
-{
+        auto task = [promise = PooledPromise<return_type>(slot), deadline = options.deadline,
+                     func = std::forward<Func>(func), args = std::make_tuple(std::forward<Args>(args)...),
+                     this]() mutable
+        {
+            if (deadlinePassed(deadline))
+            {
+                promise.setException(std::make_exception_ptr(DeadlineExceeded()));
+                return;
+            }
 
-    using CommonType = typename std::common_type<Args...>::type;
-    std::cout << "\n the arguments are as \n";
-    ((std::cout << std::forward<Args>(args) << " "), ...);
-    std::cout << std::endl;
-    return Return();
-}
+            if constexpr (ContainsStringArgs<Args...>::value)
+                stringTasksCounter.fetch_add(1, std::memory_order_relaxed);
 
-int main()
-{
-    // Create a thread pool with 4 threads
+            try
+            {
+                promise.setValue(invokeTask<return_type>(func, args));
+            }
+            catch (...)
+            {
+                promise.setException(std::current_exception());
+            }
+        };
+        static_assert(InlineTask::fitsInline<decltype(task)>,
+                      "submit() callable and arguments must fit in InlineTask::kInlineSize");
+
+        push(options, InlineTask(std::move(task)));
+
+        return result;
+    }
+
+    int getStringTasksCounter()
+    {
+        return stringTasksCounter.load(std::memory_order_relaxed);
+    }
+
+    // How long a task without an explicit deadline may wait in a lane before
+    // it outranks newer work in more urgent lanes. Finite budgets are what
+    // keep the background lane from starving.
+    void setLaneBudget(TaskPriority priority, std::chrono::microseconds budget)
+    {
+        std::unique_lock<std::mutex> lock(queueMutex);
+        laneBudgets[laneIndex(priority)] = budget;
+    }
+
+    // Queue wait of one lane, merged across workers.
+    HistogramSnapshot queueWaitHistogram(TaskPriority priority) const
+    {
+        HistogramSnapshot merged;
+        for (std::size_t worker = 0; worker < workerCount; ++worker)
+            merged += workerStats[worker].queueWait[laneIndex(priority)].snapshot();
+        return merged;
+    }
+
+    // Reads every counter without taking queueMutex; values are individually
+    // consistent but may be a few tasks apart from each other.
+    PoolSnapshot snapshot() const
+    {
+        PoolSnapshot result;
+        for (std::size_t lane = 0; lane < kPriorityLanes; ++lane)
+            result.queueDepth[lane] = laneDepth[lane].load(std::memory_order_relaxed);
+        result.stringTasks = stringTasksCounter.load(std::memory_order_relaxed);
+
+        for (std::size_t worker = 0; worker < workerCount; ++worker)
+        {
+            const WorkerStats &stats = workerStats[worker];
+            WorkerSnapshot current;
+            current.tasksRun = stats.tasksRun.load(std::memory_order_relaxed);
+            current.busyTime = std::chrono::nanoseconds(stats.busyNanos.load(std::memory_order_relaxed));
+            current.idleTime = std::chrono::nanoseconds(stats.idleNanos.load(std::memory_order_relaxed));
+            current.runTime = stats.runTime.snapshot();
+
+            for (std::size_t lane = 0; lane < kPriorityLanes; ++lane)
+                result.queueWait[lane] += stats.queueWait[lane].snapshot();
+            result.runTime += current.runTime;
+            result.tasksRun += current.tasksRun;
+            result.workers.push_back(current);
+        }
+        return result;
+    }
+
+    // Fire-and-forget submission: no future, no result slot.
+    template <typename Func>
+    void post(const TaskOptions &options, Func &&func)
+    {
+        push(options, InlineTask(std::forward<Func>(func)));
+    }
+
+    void resetStats()
+    {
+        for (std::size_t worker = 0; worker < workerCount; ++worker)
+        {
+            WorkerStats &stats = workerStats[worker];
+            stats.tasksRun.store(0, std::memory_order_relaxed);
+            stats.busyNanos.store(0, std::memory_order_relaxed);
+            stats.idleNanos.store(0, std::memory_order_relaxed);
+            stats.runTime.reset();
+            for (LatencyHistogram &histogram : stats.queueWait)
+                histogram.reset();
+        }
+    }
+
+#if defined(__cpp_impl_coroutine)
+    // Queues a suspended coroutine to be resumed by one of the workers.
+    void resume(std::coroutine_handle<> handle, TaskPriority priority = TaskPriority::Normal)
+    {
+        push(TaskOptions{priority, std::nullopt}, InlineTask([handle]()
+                                                             { handle.resume(); }));
+    }
+
+    // `co_await pool.schedule()` moves the awaiting coroutine onto a worker.
+    auto schedule(TaskPriority priority = TaskPriority::Normal)
+    {
+        struct ScheduleAwaiter
+        {
+            ThreadPool *pool;
+            TaskPriority priority;
+
+            bool await_ready() const noexcept { return false; }
+            void await_suspend(std::coroutine_handle<> handle) { pool->resume(handle, priority); }
+            void await_resume() const noexcept {}
+        };
+
+        return ScheduleAwaiter{this, priority};
+    }
+#endif
+
+private:
+    static std::size_t laneIndex(TaskPriority priority)
+    {
+        return static_cast<std::size_t>(priority);
+    }
+
+    static std::uint64_t nanosBetween(TaskClock::time_point from, TaskClock::time_point to)
+    {
+        return static_cast<std::uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(to - from).count());
+    }
+
+    void push(const TaskOptions &options, InlineTask &&task)
+    {
+        std::size_t lane = laneIndex(options.priority);
+        TaskClock::time_point now = TaskClock::now();
+        {
+            std::unique_lock<std::mutex> lock(queueMutex);
+            TaskClock::time_point dueBy = now + laneBudgets[lane];
+            if (options.deadline)
+                dueBy = std::min(dueBy, *options.deadline);
+
+            lanes[lane].push(QueuedTask{std::move(task), now, dueBy});
+            ++queuedTasks;
+            laneDepth[lane].store(lanes[lane].size(), std::memory_order_relaxed);
+        }
+
+        condition.notify_one();
+    }
+
+    // Earliest-deadline-first across the lane heads. Every queued task has a
+    // finite due time (explicit deadline or enqueue time + lane budget), so an
+    // old background task eventually outranks a fresh high-priority one.
+    std::size_t pickLane() const
+    {
+        std::size_t best = kPriorityLanes;
+        for (std::size_t lane = 0; lane < kPriorityLanes; ++lane)
+        {
+            if (lanes[lane].empty())
+                continue;
+            if (best == kPriorityLanes || lanes[lane].front().dueBy < lanes[best].front().dueBy)
+                best = lane;
+        }
+        return best;
+    }
+
+    std::vector<std::thread> threads;
+    std::array<TaskRing, kPriorityLanes> lanes;
+    std::size_t queuedTasks = 0;
+    std::array<std::chrono::microseconds, kPriorityLanes> laneBudgets = {
+        std::chrono::microseconds(1000), std::chrono::microseconds(50000), std::chrono::microseconds(500000)};
+    std::array<std::atomic<std::size_t>, kPriorityLanes> laneDepth{};
+    std::size_t workerCount;
+    std::unique_ptr<WorkerStats[]> workerStats;
+
+    std::mutex queueMutex;
+    std::condition_variable condition;
+    std::atomic<int> stringTasksCounter;
+    bool stop;
+};
+
+// Reusable DAG of tasks. Nodes and edges are declared once; every run()
+// resets per-node dependency counters and posts a node to the pool the moment
+// its last predecessor finishes, so no thread ever waits on a future for an
+// intermediate stage. A graph runs one instance at a time.
+class TaskGraph
+{
+public:
+    using NodeId = std::size_t;
+
+    NodeId addNode(std::function<void()> work, TaskPriority priority = TaskPriority::Normal)
+    {
+        nodes.push_back(Node{std::move(work), priority, {}, 0});
+        validated = false;
+        return nodes.size() - 1;
+    }
+
+    // `after` starts only once `before` has finished.
+    void addEdge(NodeId before, NodeId after)
+    {
+        if (before >= nodes.size() || after >= nodes.size())
+            throw std::out_of_range("TaskGraph edge refers to an unknown node.");
+
+        nodes[before].successors.push_back(after);
+        ++nodes[after].dependencies;
+        validated = false;
+    }
+
+    // Starts every node without dependencies on the pool. The returned future
+    // completes (with 0) after the last node has run, or carries the first
+    // exception thrown by a node; nodes downstream of a failure are skipped.
+    PooledFuture<int> run(ThreadPool &pool)
+    {
+        if (!validated)
+            validate();
+
+        bool expected = false;
+        if (!running.compare_exchange_strong(expected, true))
+            throw std::logic_error("TaskGraph is already running.");
+
+        ResultSlot<int> *slot = ResultSlotPool<int>::instance().acquire();
+        PooledFuture<int> result(slot);
+        completion.emplace(slot);
+        error = nullptr;
+        failed.store(false, std::memory_order_relaxed);
+
+        if (nodes.empty())
+        {
+            finish();
+            return result;
+        }
+
+        for (std::size_t id = 0; id < nodes.size(); ++id)
+            pendingDependencies[id].store(nodes[id].dependencies, std::memory_order_relaxed);
+        remainingNodes.store(nodes.size(), std::memory_order_relaxed);
+
+        for (NodeId root : roots)
+            schedule(pool, root);
+
+        return result;
+    }
+
+    std::size_t size() const { return nodes.size(); }
+
+private:
+    struct Node
+    {
+        std::function<void()> work;
+        TaskPriority priority;
+        std::vector<NodeId> successors;
+        std::size_t dependencies;
+    };
+
+    // One-time setup: reject cycles (Kahn's algorithm) and cache the roots and
+    // counter storage so later runs only reset counters.
+    void validate()
+    {
+        std::vector<std::size_t> indegree(nodes.size());
+        roots.clear();
+        for (std::size_t id = 0; id < nodes.size(); ++id)
+        {
+            indegree[id] = nodes[id].dependencies;
+            if (indegree[id] == 0)
+                roots.push_back(id);
+        }
+
+        std::vector<NodeId> ready(roots);
+        std::size_t visited = 0;
+        while (!ready.empty())
+        {
+            NodeId id = ready.back();
+            ready.pop_back();
+            ++visited;
+            for (NodeId next : nodes[id].successors)
+                if (--indegree[next] == 0)
+                    ready.push_back(next);
+        }
+
+        if (visited != nodes.size())
+            throw std::logic_error("TaskGraph contains a cycle.");
+
+        pendingDependencies = std::make_unique<std::atomic<std::size_t>[]>(nodes.size());
+        validated = true;
+    }
+
+    void schedule(ThreadPool &pool, NodeId id)
+    {
+        pool.post(TaskOptions{nodes[id].priority, std::nullopt}, [this, &pool, id]()
+                  { execute(pool, id); });
+    }
+
+    void execute(ThreadPool &pool, NodeId id)
+    {
+        if (!failed.load(std::memory_order_acquire))
+        {
+            try
+            {
+                nodes[id].work();
+            }
+            catch (...)
+            {
+                std::unique_lock<std::mutex> lock(errorMutex);
+                if (!error)
+                    error = std::current_exception();
+                failed.store(true, std::memory_order_release);
+            }
+        }
+
+        for (NodeId next : nodes[id].successors)
+            if (pendingDependencies[next].fetch_sub(1, std::memory_order_acq_rel) == 1)
+                schedule(pool, next);
+
+        if (remainingNodes.fetch_sub(1, std::memory_order_acq_rel) == 1)
+            finish();
+    }
+
+    // Takes the promise and the error out of the graph before releasing
+    // running: once it is false a concurrent run() may reset both. The
+    // promise is completed last so a caller woken by it can run() again.
+    void finish()
+    {
+        PooledPromise<int> promise = std::move(*completion);
+        completion.reset();
+        std::exception_ptr failure = std::exchange(error, nullptr);
+        running.store(false, std::memory_order_release);
+
+        if (failure)
+            promise.setException(failure);
+        else
+            promise.setValue(0);
+    }
+
+    std::vector<Node> nodes;
+    std::vector<NodeId> roots;
+    bool validated = false;
+
+    std::unique_ptr<std::atomic<std::size_t>[]> pendingDependencies;
+    std::atomic<std::size_t> remainingNodes{0};
+    std::atomic<bool> running{false};
+    std::atomic<bool> failed{false};
+    std::mutex errorMutex;
+    std::exception_ptr error;
+    std::optional<PooledPromise<int>> completion;
+};
+
+#if defined(__cpp_impl_coroutine)
+// Lazily started coroutine returning T. Awaiting a Task starts it and resumes
+// the awaiter (by symmetric transfer) on whichever thread finishes it, so no
+// worker ever blocks waiting for a result.
+template <typename T = void>
+class Task;
+
+template <typename T>
+class TaskPromiseBase
+{
+public:
+    struct FinalAwaiter
+    {
+        bool await_ready() noexcept { return false; }
+
+        template <typename Promise>
+        std::coroutine_handle<> await_suspend(std::coroutine_handle<Promise> handle) noexcept
+        {
+            return handle.promise().continuation;
+        }
+
+        void await_resume() noexcept {}
+    };
+
+    std::suspend_always initial_suspend() noexcept { return {}; }
+    FinalAwaiter final_suspend() noexcept { return {}; }
+
+    void unhandled_exception() { error = std::current_exception(); }
+
+    std::coroutine_handle<> continuation = std::noop_coroutine();
+    std::exception_ptr error;
+};
+
+template <typename T>
+class TaskPromise : public TaskPromiseBase<T>
+{
+public:
+    Task<T> get_return_object();
+
+    template <typename Value>
+    void return_value(Value &&value) { result.emplace(std::forward<Value>(value)); }
+
+    T take()
+    {
+        if (this->error)
+            std::rethrow_exception(this->error);
+        return std::move(*result);
+    }
+
+private:
+    std::optional<T> result;
+};
+
+template <>
+class TaskPromise<void> : public TaskPromiseBase<void>
+{
+public:
+    Task<void> get_return_object();
+
+    void return_void() {}
+
+    void take()
+    {
+        if (error)
+            std::rethrow_exception(error);
+    }
+};
+
+template <typename T>
+class Task
+{
+public:
+    using promise_type = TaskPromise<T>;
+    using Handle = std::coroutine_handle<promise_type>;
+
+    explicit Task(Handle handle) : handle(handle) {}
+    Task(Task &&other) noexcept : handle(std::exchange(other.handle, nullptr)) {}
+    Task &operator=(Task &&other) noexcept
+    {
+        if (this != &other)
+        {
+            if (handle)
+                handle.destroy();
+            handle = std::exchange(other.handle, nullptr);
+        }
+        return *this;
+    }
+
+    ~Task()
+    {
+        if (handle)
+            handle.destroy();
+    }
+
+    // Starts the task and resumes the awaiter once it has finished, without
+    // fetching the result (used by when_all to collect results afterwards).
+    auto whenReady()
+    {
+        struct ReadyAwaiter
+        {
+            Handle handle;
+
+            bool await_ready() const noexcept { return !handle || handle.done(); }
+            std::coroutine_handle<> await_suspend(std::coroutine_handle<> awaiting) noexcept
+            {
+                handle.promise().continuation = awaiting;
+                return handle;
+            }
+            void await_resume() const noexcept {}
+        };
+
+        return ReadyAwaiter{handle};
+    }
+
+    auto operator co_await()
+    {
+        struct ResultAwaiter
+        {
+            Handle handle;
+
+            bool await_ready() const noexcept { return !handle || handle.done(); }
+            std::coroutine_handle<> await_suspend(std::coroutine_handle<> awaiting) noexcept
+            {
+                handle.promise().continuation = awaiting;
+                return handle;
+            }
+            T await_resume() { return handle.promise().take(); }
+        };
+
+        return ResultAwaiter{handle};
+    }
+
+    // Result of a finished task; rethrows the exception it ended with.
+    T result() { return handle.promise().take(); }
+
+private:
+    Handle handle;
+};
+
+template <typename T>
+Task<T> TaskPromise<T>::get_return_object()
+{
+    return Task<T>(std::coroutine_handle<TaskPromise<T>>::from_promise(*this));
+}
+
+inline Task<void> TaskPromise<void>::get_return_object()
+{
+    return Task<void>(std::coroutine_handle<TaskPromise<void>>::from_promise(*this));
+}
+
+// Eagerly started, self-destroying coroutine used to drive Tasks from
+// non-coroutine code.
+struct DetachedTask
+{
+    struct promise_type
+    {
+        DetachedTask get_return_object() { return {}; }
+        std::suspend_never initial_suspend() noexcept { return {}; }
+        std::suspend_never final_suspend() noexcept { return {}; }
+        void return_void() {}
+        void unhandled_exception() { std::terminate(); }
+    };
+};
+
+// Counts outstanding when_all members; the last one to arrive (including the
+// awaiting coroutine itself) resumes the awaiter.
+class WhenAllLatch
+{
+public:
+    explicit WhenAllLatch(std::size_t members) : remaining(members + 1) {}
+
+    void arrive()
+    {
+        if (remaining.fetch_sub(1, std::memory_order_acq_rel) == 1)
+            awaiting.resume();
+    }
+
+    bool await_ready() const noexcept { return false; }
+    bool await_suspend(std::coroutine_handle<> handle) noexcept
+    {
+        awaiting = handle;
+        return remaining.fetch_sub(1, std::memory_order_acq_rel) != 1;
+    }
+    void await_resume() const noexcept {}
+
+private:
+    std::atomic<std::size_t> remaining;
+    std::coroutine_handle<> awaiting;
+};
+
+template <typename T>
+DetachedTask runWhenAllMember(Task<T> &task, WhenAllLatch &latch)
+{
+    co_await task.whenReady();
+    latch.arrive();
+}
+
+template <typename T>
+using WhenAllResult = std::conditional_t<std::is_void_v<T>, void, std::vector<T>>;
+
+// Runs every task concurrently and completes when all of them have; results
+// are returned in input order and the first failing task's exception is
+// rethrown.
+template <typename T>
+Task<WhenAllResult<T>> when_all(std::vector<Task<T>> tasks)
+{
+    WhenAllLatch latch(tasks.size());
+    for (Task<T> &task : tasks)
+        runWhenAllMember(task, latch);
+    co_await latch;
+
+    if constexpr (std::is_void_v<T>)
+    {
+        for (Task<T> &task : tasks)
+            task.result();
+    }
+    else
+    {
+        std::vector<T> results;
+        results.reserve(tasks.size());
+        for (Task<T> &task : tasks)
+            results.push_back(task.result());
+        co_return results;
+    }
+}
+
+// Blocks the calling (non-worker) thread until the task has finished.
+template <typename T>
+T syncWait(Task<T> task)
+{
+    std::mutex mutex;
+    std::condition_variable condition;
+    bool finished = false;
+
+    auto driver = [&]() -> DetachedTask
+    {
+        co_await task.whenReady();
+        // Notify under the lock: the waiter owns these and returns as soon
+        // as it observes finished.
+        std::unique_lock<std::mutex> lock(mutex);
+        finished = true;
+        condition.notify_one();
+    };
+    driver();
+
+    std::unique_lock<std::mutex> lock(mutex);
+    condition.wait(lock, [&finished]
+                   { return finished; });
+    return task.result();
+}
+#endif
+
+#ifndef THREAD_POOL_DEMO_NO_MAIN
+// Counts every global heap allocation so the demo can show that submit()
+// stops allocating once the pool has warmed up.
+static std::atomic<std::size_t> heapAllocations(0);
+
+// malloc/free are called through out-of-line helpers so GCC can't see free()
+// applied to operator new's result once delete is inlined, which it reports
+// as -Wmismatched-new-delete.
+[[gnu::noinline]] static void *countedMalloc(std::size_t size)
+{
+    heapAllocations.fetch_add(1, std::memory_order_relaxed);
+    return std::malloc(size == 0 ? 1 : size);
+}
+
+[[gnu::noinline]] static void countedFree(void *memory) { std::free(memory); }
+
+void *operator new(std::size_t size)
+{
+    if (void *memory = countedMalloc(size))
+        return memory;
+    throw std::bad_alloc();
+}
+
+void operator delete(void *memory) noexcept { countedFree(memory); }
+void operator delete(void *memory, std::size_t) noexcept { countedFree(memory); }
+
+// Example usage
+void busyFor(std::chrono::microseconds duration)
+{
+    TaskClock::time_point until = TaskClock::now() + duration;
+    while (TaskClock::now() < until)
+    {
+    }
+}
+
+// Floods the pool with background work while latency-critical requests
+// trickle in, then reports the queue wait the requests saw. The requests
+// time their own wait rather than reading the lane histogram, which in the
+// shared-lane run also holds every background task.
+void runMixedLoad(TaskPriority requestLane, TaskPriority backgroundLane)
+{
+    ThreadPool pool(2);
+    std::vector<PooledFuture<int>> pending;
+    LatencyHistogram requestWait;
+
+    for (int burst = 0; burst < 20; ++burst)
+    {
+        for (int i = 0; i < 50; ++i)
+            pending.push_back(pool.submitWith(TaskOptions{backgroundLane, std::nullopt},
+                                              busyFor, std::chrono::microseconds(100)));
+
+        TaskClock::time_point submitted = TaskClock::now();
+        pending.push_back(pool.submitWith(TaskOptions{requestLane, std::nullopt},
+                                          [&requestWait, submitted]()
+                                          {
+                                              requestWait.record(TaskClock::now() - submitted);
+                                              busyFor(std::chrono::microseconds(20));
+                                          }));
+        busyFor(std::chrono::microseconds(500));
+    }
+
+    for (auto &future : pending)
+        future.get();
+
+    HistogramSnapshot requests = requestWait.snapshot();
+    std::cout << "  request lane queue wait p50 <= " << requests.percentile(50).count()
+              << "us, p99 <= " << requests.percentile(99).count() << "us over "
+              << requests.count() << " tasks" << std::endl;
+}
+
+template <typename Return, typename... Args>
+Return printNumber(Args &&...args)
+{
+
+    using CommonType = typename std::common_type<Args...>::type;
+    std::cout << "\n the arguments are as \n";
+    ((std::cout << std::forward<Args>(args) << " "), ...);
+    std::cout << std::endl;
+    return Return();
+}
+
+int main()
+{
+    // Create a thread pool with 4 threads
     ThreadPool pool(4);
 
     std::function<std::string()> func1X = []()
@@ -206,8 +1428,6 @@ int main()
 
     auto resultVoid = pool.enqueue(func3);
 
-    std::this_thread::sleep_for(std::chrono::seconds(1));
-
     try
     {
         // Get the results of the tasks
@@ -226,5 +1446,160 @@ int main()
         // Log or handle the exception as needed
     }
 
+    // Allocation-free submission: warm the task ring and the result slot pool
+    // with a larger batch than we measure, then count mallocs per submit().
+    {
+        auto square = [](int x)
+        { return x * x; };
+
+        std::vector<PooledFuture<int>> batch;
+        batch.reserve(128);
+
+        auto runBatch = [&](int batchSize)
+        {
+            long long sum = 0;
+            for (int i = 0; i < batchSize; ++i)
+                batch.push_back(pool.submit(square, i));
+            for (auto &future : batch)
+                sum += future.get();
+            batch.clear();
+            return sum;
+        };
+
+        for (int round = 0; round < 100; ++round)
+            runBatch(128);
+
+        const int rounds = 1000;
+        const int batchSize = 64;
+        std::size_t before = heapAllocations.load();
+        for (int round = 0; round < rounds; ++round)
+            runBatch(batchSize);
+        std::size_t after = heapAllocations.load();
+
+        std::cout << "Heap allocations per submit() in steady state: "
+                  << static_cast<double>(after - before) / (rounds * batchSize) << std::endl;
+    }
+
+    // Instrumentation snapshot of the main pool
+    {
+        PoolSnapshot stats = pool.snapshot();
+        std::cout << "Tasks run: " << stats.tasksRun
+                  << ", normal lane depth: " << stats.queueDepth[static_cast<std::size_t>(TaskPriority::Normal)]
+                  << ", queue wait p99 <= "
+                  << stats.queueWait[static_cast<std::size_t>(TaskPriority::Normal)].percentile(99).count()
+                  << "us, run time p99 <= " << stats.runTime.percentile(99).count() << "us" << std::endl;
+        for (std::size_t worker = 0; worker < stats.workers.size(); ++worker)
+        {
+            const WorkerSnapshot &current = stats.workers[worker];
+            std::cout << "  worker " << worker << ": " << current.tasksRun << " tasks, busy "
+                      << std::chrono::duration_cast<std::chrono::microseconds>(current.busyTime).count()
+                      << "us, idle "
+                      << std::chrono::duration_cast<std::chrono::milliseconds>(current.idleTime).count()
+                      << "ms" << std::endl;
+        }
+    }
+
+    // Priority lanes: the same mixed load, FIFO (one lane) versus split lanes.
+    std::cout << "Mixed load, requests and background sharing the normal lane:" << std::endl;
+    runMixedLoad(TaskPriority::Normal, TaskPriority::Normal);
+    std::cout << "Mixed load, requests in the high lane:" << std::endl;
+    runMixedLoad(TaskPriority::High, TaskPriority::Background);
+
+    // Deadlines: a task that cannot start in time is dropped, not run late.
+    {
+        ThreadPool single(1);
+        auto blocker = single.submitWith(TaskOptions{TaskPriority::High, std::nullopt},
+                                         busyFor, std::chrono::microseconds(20000));
+        auto late = single.submitWith(TaskOptions{TaskPriority::High, TaskClock::now() + std::chrono::milliseconds(1)},
+                                      []()
+                                      { return 42; });
+        try
+        {
+            int value = late.get();
+            std::cout << "Late task result: " << value << std::endl;
+        }
+        catch (const DeadlineExceeded &ex)
+        {
+            std::cout << "Late task: " << ex.what() << std::endl;
+        }
+        blocker.get();
+    }
+
+    // Task graph: partition -> map x4 -> combine -> reduce -> publish, built
+    // once and run several times.
+    {
+        std::vector<int> input(1000);
+        for (int i = 0; i < static_cast<int>(input.size()); ++i)
+            input[i] = i;
+
+        const std::size_t parts = 4;
+        std::vector<std::pair<std::size_t, std::size_t>> ranges(parts);
+        std::vector<long long> mapped(parts);
+        long long combined = 0;
+        long long reduced = 0;
+
+        TaskGraph pipeline;
+        TaskGraph::NodeId partition = pipeline.addNode([&]()
+                                                       {
+            std::size_t chunk = input.size() / parts;
+            for (std::size_t part = 0; part < parts; ++part)
+                ranges[part] = {part * chunk, part + 1 == parts ? input.size() : (part + 1) * chunk}; });
+        TaskGraph::NodeId combine = pipeline.addNode([&]()
+                                                     {
+            combined = 0;
+            for (long long value : mapped)
+                combined += value; });
+        TaskGraph::NodeId reduce = pipeline.addNode([&]()
+                                                    { reduced = combined / 2; });
+        TaskGraph::NodeId publish = pipeline.addNode([&]()
+                                                     { std::cout << "Graph run published: " << reduced << std::endl; },
+                                                     TaskPriority::High);
+
+        for (std::size_t part = 0; part < parts; ++part)
+        {
+            TaskGraph::NodeId map = pipeline.addNode([&, part]()
+                                                     {
+                long long sum = 0;
+                for (std::size_t i = ranges[part].first; i < ranges[part].second; ++i)
+                    sum += 2LL * input[i];
+                mapped[part] = sum; });
+            pipeline.addEdge(partition, map);
+            pipeline.addEdge(map, combine);
+        }
+        pipeline.addEdge(combine, reduce);
+        pipeline.addEdge(reduce, publish);
+
+        for (int run = 0; run < 3; ++run)
+            pipeline.run(pool).get();
+    }
+
+#if defined(__cpp_impl_coroutine)
+    // Coroutines: handlers hop onto the pool and await each other without
+    // blocking a worker on future.get().
+    {
+        auto square = [&pool](int x) -> Task<int>
+        {
+            co_await pool.schedule();
+            co_return x * x;
+        };
+
+        auto sumOfSquares = [&pool, &square](int count) -> Task<int>
+        {
+            co_await pool.schedule(TaskPriority::High);
+            std::vector<Task<int>> parts;
+            for (int i = 1; i <= count; ++i)
+                parts.push_back(square(i));
+
+            int total = 0;
+            for (int part : co_await when_all(std::move(parts)))
+                total += part;
+            co_return total;
+        };
+
+        std::cout << "Coroutine sum of squares 1..10: " << syncWait(sumOfSquares(10)) << std::endl;
+    }
+#endif
+
     return 0;
-}
\ No newline at end of file
+}
+#endif
\ No newline at end of file
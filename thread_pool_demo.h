@@ -7,20 +7,207 @@
 #include <mutex>
 #include <condition_variable>
 #include <memory>
+#include <deque>
+#include <list>
+#include <atomic>
+#include <chrono>
+#include <tuple>
+#include <algorithm>
+#include <exception>
+#include <fstream>
+#include <sstream>
+#include <string>
+
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
 
 namespace thread_pool_demo
 {
 
+    using CpuSet = std::vector<int>;
+
+    // Parses the kernel's cpulist format ("0-3,8,10-11").
+    inline CpuSet parseCpuList(const std::string &list)
+    {
+        CpuSet cpus;
+        std::stringstream stream(list);
+        std::string range;
+        while (std::getline(stream, range, ','))
+        {
+            if (range.find_first_of("0123456789") == std::string::npos)
+                continue;
+
+            size_t dash = range.find('-');
+            int first = std::stoi(range.substr(0, dash));
+            int last = dash == std::string::npos ? first : std::stoi(range.substr(dash + 1));
+            for (int cpu = first; cpu <= last; ++cpu)
+                cpus.push_back(cpu);
+        }
+        return cpus;
+    }
+
+    inline CpuSet readCpuListFile(const std::string &path)
+    {
+        std::ifstream file(path);
+        std::string list;
+        if (file.is_open())
+            std::getline(file, list);
+        return parseCpuList(list);
+    }
+
+    // CPUs this process may run on: the cgroup/taskset mask from /proc, then
+    // the online CPUs from sysfs, then simply 0..hardware_concurrency-1.
+    inline CpuSet allowedCpus()
+    {
+        std::ifstream status("/proc/self/status");
+        std::string line;
+        const std::string key = "Cpus_allowed_list:";
+        while (std::getline(status, line))
+        {
+            if (line.compare(0, key.size(), key) == 0)
+            {
+                CpuSet cpus = parseCpuList(line.substr(key.size()));
+                if (!cpus.empty())
+                    return cpus;
+            }
+        }
+
+        CpuSet online = readCpuListFile("/sys/devices/system/cpu/online");
+        if (!online.empty())
+            return online;
+
+        CpuSet cpus;
+        for (unsigned cpu = 0; cpu < std::max(1u, std::thread::hardware_concurrency()); ++cpu)
+            cpus.push_back(static_cast<int>(cpu));
+        return cpus;
+    }
+
+    // Allowed CPUs grouped by NUMA node, from /sys/devices/system/node. Hosts
+    // without that directory are treated as a single node.
+    inline std::vector<CpuSet> numaNodes()
+    {
+        CpuSet allowed = allowedCpus();
+        std::vector<CpuSet> nodes;
+        // Node ids can have holes; stop after a run of missing ones.
+        const int kMaxMissingNodes = 8;
+        for (int node = 0, missing = 0; missing < kMaxMissingNodes; ++node)
+        {
+            std::ifstream file("/sys/devices/system/node/node" + std::to_string(node) + "/cpulist");
+            if (!file.is_open())
+            {
+                ++missing;
+                continue;
+            }
+            missing = 0;
+
+            std::string list;
+            std::getline(file, list);
+            CpuSet cpus;
+            for (int cpu : parseCpuList(list))
+                if (std::find(allowed.begin(), allowed.end(), cpu) != allowed.end())
+                    cpus.push_back(cpu);
+            if (!cpus.empty())
+                nodes.push_back(cpus);
+        }
+
+        if (nodes.empty())
+            nodes.push_back(allowed);
+        return nodes;
+    }
+
+    // Restricts the calling thread to the given CPUs. Returns false when
+    // affinity is unsupported on this platform or the kernel rejects it.
+    inline bool pinCurrentThread(const CpuSet &cpus)
+    {
+#ifdef __linux__
+        cpu_set_t mask;
+        CPU_ZERO(&mask);
+        for (int cpu : cpus)
+            if (cpu >= 0 && cpu < CPU_SETSIZE)
+                CPU_SET(cpu, &mask);
+        return pthread_setaffinity_np(pthread_self(), sizeof(mask), &mask) == 0;
+#else
+        (void)cpus;
+        return false;
+#endif
+    }
+
+    // CPU the calling thread is running on right now, or -1 if unknown.
+    inline int currentCpu()
+    {
+#ifdef __linux__
+        return sched_getcpu();
+#else
+        return -1;
+#endif
+    }
+
+    // Counts outstanding work and lets any number of threads block until the
+    // count drops to zero, so callers never have to sleep and poll for a batch.
+    class WaitGroup
+    {
+    public:
+        explicit WaitGroup(size_t count = 0)
+            : pending(count)
+        {
+        }
+
+        void add(size_t count)
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            pending += count;
+        }
+
+        void done()
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            if (--pending == 0)
+                condition.notify_all();
+        }
+
+        void wait()
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            condition.wait(lock, [this]
+                           { return pending == 0; });
+        }
+
+    private:
+        std::mutex mutex;
+        std::condition_variable condition;
+        size_t pending;
+    };
+
     class ThreadPool
     {
     public:
         explicit ThreadPool(size_t numThreads)
+            : ThreadPool(numThreads, std::vector<CpuSet>())
+        {
+        }
+
+        // With pinWorkers set, worker i is pinned to the i-th allowed CPU
+        // (wrapping around), so the OS no longer migrates it between cores.
+        ThreadPool(size_t numThreads, bool pinWorkers)
+            : ThreadPool(numThreads, pinWorkers ? oneCpuPerWorker() : std::vector<CpuSet>())
+        {
+        }
+
+        // Worker i is restricted to workerAffinity[i % size]; an empty list
+        // leaves scheduling to the OS.
+        ThreadPool(size_t numThreads, const std::vector<CpuSet> &workerAffinity)
             : stop(false)
         {
             for (size_t i = 0; i < numThreads; ++i)
             {
-                threads.emplace_back([this]
+                CpuSet cpus = workerAffinity.empty() ? CpuSet() : workerAffinity[i % workerAffinity.size()];
+                threads.emplace_back([this, cpus]
                                      {
+                if (!cpus.empty())
+                    pinCurrentThread(cpus);
+
                 while (true) {
                     std::function<void()> task;
 
@@ -67,7 +254,119 @@ namespace thread_pool_demo
             condition.notify_one();
         }
 
+        // Pushes a whole batch under a single acquisition of queueMutex.
+        void enqueueBatch(std::vector<std::function<void()>> tasks)
+        {
+            if (tasks.empty())
+                return;
+
+            {
+                std::unique_lock<std::mutex> lock(queueMutex);
+                for (std::function<void()> &task : tasks)
+                    taskQueue.push(std::move(task));
+            }
+
+            if (tasks.size() >= threads.size())
+                condition.notify_all();
+            else
+                for (size_t i = 0; i < tasks.size(); ++i)
+                    condition.notify_one();
+        }
+
+        // Runs body(i) for every i in [first, last), split into chunks of at
+        // least `grain` indices, and returns once every chunk has finished.
+        // The first exception thrown by body is rethrown here. Must be called
+        // from outside the pool: the caller blocks until the batch is done.
+        template <typename Body>
+        void parallel_for(size_t first, size_t last, size_t grain, Body body)
+        {
+            runChunked(first, last, grain, [&body](size_t begin, size_t end, size_t)
+                       {
+                for (size_t i = begin; i < end; ++i)
+                    body(i); });
+        }
+
+        // Folds map(i) over [first, last) with combine, starting each chunk
+        // from identity. Partial results are combined in chunk order, so the
+        // result is deterministic for associative (not necessarily
+        // commutative) combine functions.
+        template <typename T, typename Map, typename Combine>
+        T parallel_reduce(size_t first, size_t last, size_t grain, T identity, Map map, Combine combine)
+        {
+            std::vector<T> partials(chunkCount(first, last, grain), identity);
+
+            runChunked(first, last, grain, [&](size_t begin, size_t end, size_t chunk)
+                       {
+                T value = identity;
+                for (size_t i = begin; i < end; ++i)
+                    value = combine(std::move(value), map(i));
+                partials[chunk] = std::move(value); });
+
+            T result = identity;
+            for (T &partial : partials)
+                result = combine(std::move(result), std::move(partial));
+            return result;
+        }
+
     private:
+        static std::vector<CpuSet> oneCpuPerWorker()
+        {
+            std::vector<CpuSet> affinity;
+            for (int cpu : allowedCpus())
+                affinity.push_back(CpuSet{cpu});
+            return affinity;
+        }
+
+        static size_t chunkCount(size_t first, size_t last, size_t grain)
+        {
+            if (last <= first)
+                return 0;
+
+            grain = std::max<size_t>(grain, 1);
+            return (last - first + grain - 1) / grain;
+        }
+
+        template <typename ChunkBody>
+        void runChunked(size_t first, size_t last, size_t grain, const ChunkBody &chunkBody)
+        {
+            size_t chunks = chunkCount(first, last, grain);
+            if (chunks == 0)
+                return;
+
+            grain = std::max<size_t>(grain, 1);
+
+            WaitGroup group(chunks);
+            std::mutex errorMutex;
+            std::exception_ptr error;
+
+            std::vector<std::function<void()>> batch;
+            batch.reserve(chunks);
+            for (size_t chunk = 0; chunk < chunks; ++chunk)
+            {
+                size_t begin = first + chunk * grain;
+                size_t end = std::min(last, begin + grain);
+                batch.emplace_back([&, begin, end, chunk]
+                                   {
+                    try
+                    {
+                        chunkBody(begin, end, chunk);
+                    }
+                    catch (...)
+                    {
+                        std::unique_lock<std::mutex> lock(errorMutex);
+                        if (!error)
+                            error = std::current_exception();
+                    }
+                    group.done(); });
+            }
+
+            enqueueBatch(std::move(batch));
+            group.wait();
+
+            if (error)
+                std::rethrow_exception(error);
+        }
+
         std::vector<std::thread> threads;
         std::queue<std::function<void()>> taskQueue;
 
@@ -77,10 +376,406 @@ namespace thread_pool_demo
         bool stop;
     };
 
+    enum class ShardingMode
+    {
+        PerCore,
+        PerNumaNode
+    };
+
+    // One independent ThreadPool (own queue, own lock) per core or NUMA node,
+    // with workers pinned to their shard's CPUs. enqueue() routes to the
+    // shard owning the CPU the submitter is currently running on, so work
+    // stays close to the cache that produced it.
+    class ShardedThreadPool
+    {
+    public:
+        // threadsPerShard == 0 means one worker per CPU in the shard.
+        explicit ShardedThreadPool(ShardingMode mode = ShardingMode::PerCore, size_t threadsPerShard = 0)
+            : nextShard(0)
+        {
+            std::vector<CpuSet> shardCpus;
+            if (mode == ShardingMode::PerCore)
+            {
+                for (int cpu : allowedCpus())
+                    shardCpus.push_back(CpuSet{cpu});
+            }
+            else
+            {
+                shardCpus = numaNodes();
+            }
+
+            for (size_t shard = 0; shard < shardCpus.size(); ++shard)
+            {
+                const CpuSet &cpus = shardCpus[shard];
+                size_t workers = threadsPerShard == 0 ? cpus.size() : threadsPerShard;
+                shards.push_back(std::make_unique<ThreadPool>(workers, std::vector<CpuSet>{cpus}));
+
+                for (int cpu : cpus)
+                {
+                    if (static_cast<size_t>(cpu) >= cpuToShard.size())
+                        cpuToShard.resize(cpu + 1, -1);
+                    cpuToShard[cpu] = static_cast<int>(shard);
+                }
+            }
+        }
+
+        template <typename Func, typename... Args>
+        void enqueue(Func &&func, Args &&...args)
+        {
+            enqueueOn(localShard(), std::forward<Func>(func), std::forward<Args>(args)...);
+        }
+
+        template <typename Func, typename... Args>
+        void enqueueOn(size_t shard, Func &&func, Args &&...args)
+        {
+            shards[shard % shards.size()]->enqueue(std::forward<Func>(func), std::forward<Args>(args)...);
+        }
+
+        size_t shardCount() const
+        {
+            return shards.size();
+        }
+
+        // Shard for the submitter's current CPU; submitters running outside
+        // every shard (e.g. excluded by the affinity mask) are spread
+        // round-robin.
+        size_t localShard()
+        {
+            int cpu = currentCpu();
+            if (cpu >= 0 && static_cast<size_t>(cpu) < cpuToShard.size() && cpuToShard[cpu] >= 0)
+                return static_cast<size_t>(cpuToShard[cpu]);
+
+            return nextShard.fetch_add(1, std::memory_order_relaxed) % shards.size();
+        }
+
+    private:
+        std::vector<std::unique_ptr<ThreadPool>> shards;
+        std::vector<int> cpuToShard;
+        std::atomic<size_t> nextShard;
+    };
+
+    // Work-stealing variant of ThreadPool: every worker owns a deque, tasks
+    // enqueued from a worker go to its own deque and idle workers steal from
+    // the front of the others' deques instead of contending on one queue lock.
+    class WorkStealingThreadPool
+    {
+    public:
+        explicit WorkStealingThreadPool(size_t numThreads)
+            : queues(numThreads == 0 ? 1 : numThreads), nextQueue(0), pendingTasks(0), idleWorkers(0), stop(false)
+        {
+            for (size_t i = 0; i < queues.size(); ++i)
+            {
+                threads.emplace_back([this, i]
+                                     { workerLoop(i); });
+            }
+        }
+
+        ~WorkStealingThreadPool()
+        {
+            {
+                std::unique_lock<std::mutex> lock(sleepMutex);
+                stop = true;
+            }
+
+            condition.notify_all();
+
+            for (std::thread &thread : threads)
+                thread.join();
+        }
+
+        template <typename Func, typename... Args>
+        void enqueue(Func &&func, Args &&...args)
+        {
+            std::function<void()> task([func = std::forward<Func>(func), args = std::make_tuple(std::forward<Args>(args)...)]() mutable
+                                       { std::apply(std::move(func), std::move(args)); });
+
+            // Tasks submitted by one of our own workers stay local (LIFO for
+            // cache locality); external submitters are spread round-robin.
+            size_t index;
+            if (currentPool == this)
+                index = currentIndex;
+            else
+                index = nextQueue.fetch_add(1, std::memory_order_relaxed) % queues.size();
+
+            {
+                std::unique_lock<std::mutex> lock(queues[index].mutex);
+                queues[index].tasks.push_back(std::move(task));
+            }
+
+            pendingTasks.fetch_add(1);
+
+            // Only touch the sleep lock when somebody may actually be asleep.
+            if (idleWorkers.load() > 0)
+            {
+                {
+                    std::unique_lock<std::mutex> lock(sleepMutex);
+                }
+                condition.notify_one();
+            }
+        }
+
+    private:
+        struct WorkerQueue
+        {
+            std::mutex mutex;
+            std::deque<std::function<void()>> tasks;
+        };
+
+        void workerLoop(size_t index)
+        {
+            currentPool = this;
+            currentIndex = index;
+
+            while (true)
+            {
+                std::function<void()> task;
+
+                if (popLocal(index, task) || steal(index, task))
+                {
+                    pendingTasks.fetch_sub(1);
+                    task();
+                    continue;
+                }
+
+                // Work exists but is being popped or its deque is contended:
+                // back off instead of parking on the shared sleep lock.
+                if (pendingTasks.load() > 0)
+                {
+                    std::this_thread::yield();
+                    continue;
+                }
+
+                std::unique_lock<std::mutex> lock(sleepMutex);
+                idleWorkers.fetch_add(1);
+                condition.wait(lock, [this]
+                               { return stop || pendingTasks.load() > 0; });
+                idleWorkers.fetch_sub(1);
+
+                if (stop && pendingTasks.load() == 0)
+                    return;
+            }
+        }
+
+        bool popLocal(size_t index, std::function<void()> &task)
+        {
+            WorkerQueue &queue = queues[index];
+            std::unique_lock<std::mutex> lock(queue.mutex);
+            if (queue.tasks.empty())
+                return false;
+
+            task = std::move(queue.tasks.back());
+            queue.tasks.pop_back();
+            return true;
+        }
+
+        bool steal(size_t thief, std::function<void()> &task)
+        {
+            for (size_t offset = 1; offset < queues.size(); ++offset)
+            {
+                WorkerQueue &victim = queues[(thief + offset) % queues.size()];
+                std::unique_lock<std::mutex> lock(victim.mutex, std::try_to_lock);
+                if (!lock.owns_lock() || victim.tasks.empty())
+                    continue;
+
+                task = std::move(victim.tasks.front());
+                victim.tasks.pop_front();
+                return true;
+            }
+
+            return false;
+        }
+
+        std::vector<std::thread> threads;
+        std::vector<WorkerQueue> queues;
+        std::atomic<size_t> nextQueue;
+
+        std::atomic<size_t> pendingTasks;
+        std::atomic<size_t> idleWorkers;
+        std::mutex sleepMutex;
+        std::condition_variable condition;
+
+        bool stop;
+
+        static inline thread_local WorkStealingThreadPool *currentPool = nullptr;
+        static inline thread_local size_t currentIndex = 0;
+    };
+
+    struct ElasticPoolOptions
+    {
+        size_t minThreads = 1;
+        size_t maxThreads = 16;
+        // Grow when the oldest queued task has waited longer than this.
+        std::chrono::microseconds targetQueueWait = std::chrono::milliseconds(5);
+        // Retire a worker (down to minThreads) after idling this long.
+        std::chrono::milliseconds idleTimeout = std::chrono::seconds(2);
+    };
+
+    // ThreadPool whose worker count follows queue latency: a worker is added
+    // when the head of the queue has waited past targetQueueWait and nobody is
+    // idle, and workers above minThreads retire after idleTimeout. Each
+    // enqueue wakes at most one sleeping worker.
+    class ElasticThreadPool
+    {
+    public:
+        explicit ElasticThreadPool(const ElasticPoolOptions &options)
+            : options(options), idleWorkers(0), stop(false)
+        {
+            this->options.minThreads = std::max<size_t>(this->options.minThreads, 1);
+            this->options.maxThreads = std::max(this->options.maxThreads, this->options.minThreads);
+
+            std::unique_lock<std::mutex> lock(queueMutex);
+            for (size_t i = 0; i < this->options.minThreads; ++i)
+                spawnWorker();
+        }
+
+        ~ElasticThreadPool()
+        {
+            {
+                std::unique_lock<std::mutex> lock(queueMutex);
+                stop = true;
+            }
+
+            condition.notify_all();
+
+            // Workers retiring during shutdown move themselves to `retired`,
+            // so join whatever is in either list until both are drained.
+            std::unique_lock<std::mutex> lock(queueMutex);
+            while (!workers.empty() || !retired.empty())
+            {
+                std::vector<std::thread> joinable;
+                for (std::thread &thread : retired)
+                    joinable.push_back(std::move(thread));
+                retired.clear();
+                if (joinable.empty())
+                {
+                    lock.unlock();
+                    std::this_thread::yield();
+                    lock.lock();
+                    continue;
+                }
+
+                lock.unlock();
+                for (std::thread &thread : joinable)
+                    thread.join();
+                lock.lock();
+            }
+        }
+
+        template <typename Func, typename... Args>
+        void enqueue(Func &&func, Args &&...args)
+        {
+            bool wake;
+            {
+                std::unique_lock<std::mutex> lock(queueMutex);
+                taskQueue.push_back(QueuedTask{
+                    [func = std::forward<Func>(func), args = std::make_tuple(std::forward<Args>(args)...)]() mutable
+                    { std::apply(std::move(func), std::move(args)); },
+                    std::chrono::steady_clock::now()});
+
+                wake = idleWorkers > 0;
+                if (!wake)
+                    growIfBehind();
+            }
+
+            if (wake)
+                condition.notify_one();
+        }
+
+        size_t size()
+        {
+            std::unique_lock<std::mutex> lock(queueMutex);
+            return workers.size();
+        }
+
+    private:
+        struct QueuedTask
+        {
+            std::function<void()> task;
+            std::chrono::steady_clock::time_point enqueuedAt;
+        };
+
+        // Caller holds queueMutex.
+        void spawnWorker()
+        {
+            joinRetired();
+
+            auto self = workers.emplace(workers.end());
+            *self = std::thread([this, self]
+                                { workerLoop(self); });
+        }
+
+        // Caller holds queueMutex.
+        void growIfBehind()
+        {
+            if (taskQueue.empty() || idleWorkers > 0 || workers.size() >= options.maxThreads)
+                return;
+
+            auto waited = std::chrono::steady_clock::now() - taskQueue.front().enqueuedAt;
+            if (waited > options.targetQueueWait)
+                spawnWorker();
+        }
+
+        // Caller holds queueMutex. Retired threads have already left their
+        // loop, so joining them here is quick.
+        void joinRetired()
+        {
+            for (std::thread &thread : retired)
+                thread.join();
+            retired.clear();
+        }
+
+        void workerLoop(std::list<std::thread>::iterator self)
+        {
+            std::unique_lock<std::mutex> lock(queueMutex);
+            while (true)
+            {
+                if (taskQueue.empty() && !stop)
+                {
+                    ++idleWorkers;
+                    bool woke = condition.wait_for(lock, options.idleTimeout, [this]
+                                                   { return stop || !taskQueue.empty(); });
+                    --idleWorkers;
+
+                    if (!woke && workers.size() > options.minThreads)
+                        break;
+                    continue;
+                }
+
+                if (taskQueue.empty())
+                    break;
+
+                std::function<void()> task = std::move(taskQueue.front().task);
+                taskQueue.pop_front();
+
+                lock.unlock();
+                task();
+                lock.lock();
+
+                // Sustained load: if work is still piling up, add a peer.
+                growIfBehind();
+            }
+
+            retired.push_back(std::move(*self));
+            workers.erase(self);
+        }
+
+        ElasticPoolOptions options;
+        std::list<std::thread> workers;
+        std::vector<std::thread> retired;
+        std::deque<QueuedTask> taskQueue;
+
+        std::mutex queueMutex;
+        std::condition_variable condition;
+        size_t idleWorkers;
+
+        bool stop;
+    };
+
     // Example usage
-    void printNumber(int number)
+    void printNumber(int number, WaitGroup &group)
     {
         std::cout << "Number: " << number << std::endl;
+        group.done();
     }
 
     int main()
@@ -89,13 +784,65 @@ namespace thread_pool_demo
         ThreadPool pool(4);
 
         // Enqueue tasks
+        WaitGroup group(10);
         for (int i = 0; i < 10; ++i)
         {
-            pool.enqueue(printNumber, i);
+            pool.enqueue(printNumber, i, std::ref(group));
         }
 
         // Wait for tasks to complete
-        std::this_thread::sleep_for(std::chrono::seconds(1));
+        group.wait();
+
+        // Bulk primitives
+        std::vector<int> squares(1000);
+        pool.parallel_for(0, squares.size(), 64, [&squares](size_t i)
+                          { squares[i] = static_cast<int>(i * i); });
+
+        long long sum = pool.parallel_reduce(
+            0, squares.size(), 64, 0LL,
+            [&squares](size_t i)
+            { return static_cast<long long>(squares[i]); },
+            [](long long a, long long b)
+            { return a + b; });
+        std::cout << "Sum of squares below 1000: " << sum << std::endl;
+
+        // Pinned, per-core sharded pool
+        {
+            ShardedThreadPool sharded(ShardingMode::PerCore);
+            WaitGroup shardGroup(sharded.shardCount());
+            for (size_t shard = 0; shard < sharded.shardCount(); ++shard)
+            {
+                sharded.enqueueOn(shard, [shard, &shardGroup]
+                                  {
+                    std::cout << "Shard " << shard << " running on CPU " << currentCpu() << std::endl;
+                    shardGroup.done(); });
+            }
+            shardGroup.wait();
+        }
+
+        // Elastic pool: grows under a burst, shrinks back once it goes quiet
+        {
+            ElasticPoolOptions options;
+            options.minThreads = 1;
+            options.maxThreads = 8;
+            options.targetQueueWait = std::chrono::milliseconds(1);
+            options.idleTimeout = std::chrono::milliseconds(50);
+            ElasticThreadPool elastic(options);
+
+            WaitGroup burst(200);
+            for (int i = 0; i < 200; ++i)
+            {
+                elastic.enqueue([&burst]
+                                {
+                    std::this_thread::sleep_for(std::chrono::milliseconds(2));
+                    burst.done(); });
+            }
+            burst.wait();
+            std::cout << "Elastic pool workers after burst: " << elastic.size() << std::endl;
+
+            std::this_thread::sleep_for(std::chrono::milliseconds(200));
+            std::cout << "Elastic pool workers after idling: " << elastic.size() << std::endl;
+        }
 
         return 0;
     }
@@ -0,0 +1,218 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <cstddef>
+#include <limits>
+#include <list>
+#include <unordered_map>
+
+namespace timing_wheel
+{
+
+    // Hierarchical timing wheel: tracks a deadline per key and hands back the
+    // keys whose deadline has passed.
+    //
+    // Time is cut into ticks. Level 0 has one slot per tick for the next 64
+    // ticks, level 1 one slot per 64 ticks, and so on; a key sits in the
+    // coarsest level that still tells it apart from "now". When the current
+    // tick crosses a slot boundary at level l, that slot's keys are
+    // re-inserted and fall to a finer level (cascading). Eleven levels of six
+    // bits cover the whole 64-bit tick range, so nothing overflows.
+    //
+    // schedule() and cancel() are O(1). advance() moves to now and expires
+    // at most `budget` keys per call, leaving the rest queued for the next
+    // call, so an owner can expire incrementally from its hot path instead of
+    // scanning everything at once. A bitmask of occupied slots per level lets
+    // it jump straight to the next tick that has work, so idle time costs at
+    // most a few steps per level rather than one per tick.
+    //
+    // Not thread-safe: the owner serialises access (Cache does it under the
+    // shard lock). Deadlines are rounded up to a whole tick, so a key never
+    // expires early; it may expire up to one tick late.
+    template <typename Key, typename Clock = std::chrono::steady_clock>
+    class TimingWheel
+    {
+    public:
+        using TimePoint = typename Clock::time_point;
+        using Tick = std::uint64_t;
+
+        explicit TimingWheel(typename Clock::duration tick, TimePoint origin = Clock::now())
+            : tick_(std::max<typename Clock::duration>(tick, typename Clock::duration(1))), origin_(origin)
+        {
+        }
+
+        // Adds the key, or moves it if already scheduled.
+        void schedule(const Key &key, TimePoint deadline)
+        {
+            cancel(key);
+            Tick at = toTick(deadline, true);
+            std::size_t slot = slotFor(at);
+            slots_[slot].push_front(key);
+            markOccupied(slot);
+            index_.emplace(key, Location{slot, slots_[slot].begin(), at});
+        }
+
+        void cancel(const Key &key)
+        {
+            auto it = index_.find(key);
+            if (it == index_.end())
+                return;
+            std::size_t slot = it->second.slot;
+            slots_[slot].erase(it->second.position);
+            index_.erase(it);
+            if (slots_[slot].empty())
+                clearOccupied(slot);
+        }
+
+        bool contains(const Key &key) const { return index_.count(key) != 0; }
+        std::size_t size() const { return index_.size(); }
+        bool empty() const { return index_.empty(); }
+
+        // Expires keys whose deadline is at or before `now`, calling
+        // expire(key) for at most `budget` of them (the key is already gone
+        // from the wheel when expire runs). Returns how many expired.
+        template <typename Expire>
+        std::size_t advance(TimePoint now, Expire &&expire,
+                            std::size_t budget = std::numeric_limits<std::size_t>::max())
+        {
+            Tick target = toTick(now, false);
+            std::size_t expired = 0;
+            while (true)
+            {
+                std::list<Key> &due = slots_[kDueSlot];
+                while (!due.empty() && expired < budget)
+                {
+                    Key key = due.back();
+                    due.pop_back();
+                    index_.erase(key);
+                    expire(key);
+                    ++expired;
+                }
+                if (expired >= budget || current_ >= target)
+                    break;
+
+                // Skip the ticks on which nothing would happen; with nothing
+                // left in the wheel proper that is everything up to now.
+                Tick next = nextEvent();
+                if (next > target)
+                {
+                    current_ = target;
+                    break;
+                }
+                current_ = next - 1;
+                step();
+            }
+            return expired;
+        }
+
+    private:
+        static constexpr std::size_t kBits = 6;
+        static constexpr std::size_t kSlotsPerLevel = std::size_t(1) << kBits;
+        static constexpr std::size_t kLevels = (64 + kBits - 1) / kBits;
+        static constexpr std::size_t kDueSlot = kLevels * kSlotsPerLevel;
+
+        struct Location
+        {
+            std::size_t slot;
+            typename std::list<Key>::iterator position;
+            Tick deadline;
+        };
+
+        Tick toTick(TimePoint time, bool roundUp) const
+        {
+            if (time <= origin_)
+                return 0;
+            auto elapsed = time - origin_;
+            Tick ticks = static_cast<Tick>(elapsed / tick_);
+            if (roundUp && elapsed % tick_ != Clock::duration::zero())
+                ++ticks;
+            return ticks;
+        }
+
+        // Level = highest 6-bit group in which the deadline differs from the
+        // current tick; the slot is the deadline's digit in that group.
+        std::size_t slotFor(Tick deadline) const
+        {
+            if (deadline <= current_)
+                return kDueSlot;
+            Tick differing = deadline ^ current_;
+            std::size_t level = 0;
+            while (level + 1 < kLevels && (differing >> (kBits * (level + 1))) != 0)
+                ++level;
+            std::size_t digit = static_cast<std::size_t>(deadline >> (kBits * level)) & (kSlotsPerLevel - 1);
+            return level * kSlotsPerLevel + digit;
+        }
+
+        void markOccupied(std::size_t slot)
+        {
+            if (slot != kDueSlot)
+                occupied_[slot / kSlotsPerLevel] |= std::uint64_t(1) << (slot % kSlotsPerLevel);
+        }
+
+        void clearOccupied(std::size_t slot)
+        {
+            if (slot != kDueSlot)
+                occupied_[slot / kSlotsPerLevel] &= ~(std::uint64_t(1) << (slot % kSlotsPerLevel));
+        }
+
+        // The first tick after current_ at which step() touches an occupied
+        // slot. A slot at level l with digit d (always above current_'s
+        // digit there) is reached when current_'s digit at l becomes d with
+        // every lower digit zero; the digits above l are current_'s own.
+        Tick nextEvent() const
+        {
+            Tick next = std::numeric_limits<Tick>::max();
+            for (std::size_t level = 0; level < kLevels; ++level)
+            {
+                std::uint64_t mask = occupied_[level];
+                if (mask == 0)
+                    continue;
+                std::size_t shift = kBits * level;
+                std::size_t digit = (static_cast<std::size_t>(current_ >> shift) & (kSlotsPerLevel - 1)) + 1;
+                while (digit < kSlotsPerLevel && ((mask >> digit) & 1) == 0)
+                    ++digit;
+                if (digit == kSlotsPerLevel)
+                    continue;
+                Tick above = shift + kBits < 64 ? current_ & ~((Tick(1) << (shift + kBits)) - 1) : 0;
+                next = std::min(next, above | (Tick(digit) << shift));
+            }
+            return next;
+        }
+
+        // Moves to the next tick: cascades every level whose boundary was
+        // crossed (coarsest first), then drains level 0's slot into due.
+        void step()
+        {
+            ++current_;
+            std::size_t crossed = 0;
+            while (crossed + 1 < kLevels && (current_ & ((Tick(1) << (kBits * (crossed + 1))) - 1)) == 0)
+                ++crossed;
+
+            for (std::size_t level = crossed + 1; level-- > 0;)
+            {
+                std::size_t digit = static_cast<std::size_t>(current_ >> (kBits * level)) & (kSlotsPerLevel - 1);
+                std::list<Key> &slot = slots_[level * kSlotsPerLevel + digit];
+                clearOccupied(level * kSlotsPerLevel + digit);
+                while (!slot.empty())
+                {
+                    Location &location = index_.find(slot.front())->second;
+                    std::size_t target = slotFor(location.deadline);
+                    slots_[target].splice(slots_[target].begin(), slot, slot.begin());
+                    markOccupied(target);
+                    location.slot = target;
+                }
+            }
+        }
+
+        typename Clock::duration tick_;
+        TimePoint origin_;
+        Tick current_ = 0;
+        std::array<std::list<Key>, kDueSlot + 1> slots_;
+        std::array<std::uint64_t, kLevels> occupied_{}; // bit d of level l: slot l*64+d is non-empty
+        std::unordered_map<Key, Location> index_;
+    };
+
+}
@@ -3,42 +3,214 @@
 #include <chrono>
 #include <ctime>
 #include <ratio>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <memory>
+
+#include "mmap_cache_tier.h"
 
 using namespace std;
 using namespace std::chrono;
 
+// Where an entry is in its refresh cycle.
+enum class RefreshState {
+    Fresh,      // nothing pending
+    Scheduled,  // queued for the background worker
+    Refreshing, // the worker is regenerating it right now
+    Failed      // the last background refresh threw; retried on next read
+};
+
+const char* refreshStateName(RefreshState state) {
+    switch (state) {
+    case RefreshState::Fresh:
+        return "fresh";
+    case RefreshState::Scheduled:
+        return "scheduled";
+    case RefreshState::Refreshing:
+        return "refreshing";
+    case RefreshState::Failed:
+        return "failed";
+    }
+    return "unknown";
+}
+
+// Caches weather reports with refresh-ahead and stale-while-revalidate:
+//   age < ttl - refreshAhead          served as is
+//   age < ttl                         served, and a background refresh queued
+//   age < ttl + staleGrace            served stale, and a background refresh queued
+//   older, or not cached              regenerated on the caller's path
+// So only the very first read of a resort (or one idle past the grace
+// period) pays for generateWeatherReport.
+//
+// With a second tier (a memory-mapped file), reports also outlive the
+// process: a cold cache checks the file before generating, and every
+// generated report is written through to it.
 class WeatherReportService {
 private:
-    unordered_map<string, pair<system_clock::time_point, string>> cache;
+    struct Entry {
+        system_clock::time_point generatedAt;
+        string report;
+        RefreshState state = RefreshState::Fresh;
+    };
+
+    const system_clock::duration ttl;
+    const system_clock::duration refreshAhead;
+    const system_clock::duration staleGrace;
+
+    mutex cacheMutex;
+    condition_variable refreshReady;
+    unordered_map<string, Entry> cache;
+    deque<string> refreshQueue;
+    bool stopping = false;
+    shared_ptr<mmap_cache_tier::L2Tier<string, string>> secondTier;
+    thread refresher;
 
 public:
+    WeatherReportService(system_clock::duration ttl = seconds(3600),
+                         system_clock::duration refreshAhead = seconds(300),
+                         system_clock::duration staleGrace = seconds(600),
+                         shared_ptr<mmap_cache_tier::L2Tier<string, string>> secondTier = nullptr)
+        : ttl(ttl), refreshAhead(min(refreshAhead, ttl)), staleGrace(staleGrace), secondTier(move(secondTier)),
+          refresher([this] { refreshLoop(); }) {}
+
+    ~WeatherReportService() {
+        {
+            lock_guard<mutex> lock(cacheMutex);
+            stopping = true;
+        }
+        refreshReady.notify_one();
+        refresher.join();
+    }
+
     string getWeatherReport(const string& resort) {
-        if (cache.find(resort) != cache.end()) {
-            const auto& cachedData = cache[resort];
-            if (cachedData.first + seconds(3600) > system_clock::now()) {
-                cout << "Returning cached weather report for " << resort << endl;
-                return cachedData.second;
+        {
+            unique_lock<mutex> lock(cacheMutex);
+            auto it = cache.find(resort);
+            if (it != cache.end()) {
+                Entry& entry = it->second;
+                system_clock::duration age = system_clock::now() - entry.generatedAt;
+                if (age < ttl + staleGrace) {
+                    if (age >= ttl - refreshAhead) {
+                        scheduleRefresh(resort, entry);
+                    }
+                    cout << (age < ttl ? "Returning cached weather report for " : "Returning stale weather report for ")
+                         << resort << endl;
+                    return entry.report;
+                }
             }
         }
 
-        string weatherReport = generateWeatherReport(resort);
+        // The second tier stores how long a report stays servable (TTL plus
+        // grace), from which the original generation time is recovered.
+        string weatherReport;
+        system_clock::time_point generatedAt;
+        system_clock::time_point storedUntil;
+        optional<string> stored = secondTier ? secondTier->get(resort, &storedUntil) : nullopt;
+        if (stored) {
+            cout << "Returning stored weather report for " << resort << endl;
+            weatherReport = move(*stored);
+            generatedAt = storedUntil - ttl - staleGrace;
+        }
+        else {
+            weatherReport = generateWeatherReport(resort);
+            generatedAt = system_clock::now();
+            storeSecondTier(resort, weatherReport, generatedAt);
+        }
 
         // Update cache with new data
-        cache[resort] = { system_clock::now(), weatherReport };
+        lock_guard<mutex> lock(cacheMutex);
+        Entry& entry = cache[resort];
+        entry.generatedAt = generatedAt;
+        entry.report = weatherReport;
+        if (entry.state == RefreshState::Failed) {
+            entry.state = RefreshState::Fresh;
+        }
 
         return weatherReport;
     }
 
+    RefreshState refreshState(const string& resort) {
+        lock_guard<mutex> lock(cacheMutex);
+        auto it = cache.find(resort);
+        return it == cache.end() ? RefreshState::Fresh : it->second.state;
+    }
+
     string generateWeatherReport(const string& resort) {
         // Simulate generating the weather report
         // In a real implementation, this would involve retrieving data from a source
         // such as an API or database and constructing the report
 
         // Here, we generate a sample report consisting of the resort name and current date
+        // ctime_r rather than ctime: the background refresher runs this too.
         time_t now = system_clock::to_time_t(system_clock::now());
-        string report = resort + " weather report on " + string(ctime(&now));
+        char date[26];
+        string report = resort + " weather report on " + string(ctime_r(&now, date));
         return report;
     }
+
+private:
+    void storeSecondTier(const string& resort, const string& report, system_clock::time_point generatedAt) {
+        if (secondTier) {
+            secondTier->put(resort, report, generatedAt + ttl + staleGrace);
+        }
+    }
+
+    // Caller holds cacheMutex. At most one refresh per entry is outstanding.
+    void scheduleRefresh(const string& resort, Entry& entry) {
+        if (entry.state == RefreshState::Scheduled || entry.state == RefreshState::Refreshing) {
+            return;
+        }
+        entry.state = RefreshState::Scheduled;
+        refreshQueue.push_back(resort);
+        refreshReady.notify_one();
+    }
+
+    void refreshLoop() {
+        unique_lock<mutex> lock(cacheMutex);
+        while (true) {
+            refreshReady.wait(lock, [this] { return stopping || !refreshQueue.empty(); });
+            if (stopping) {
+                return;
+            }
+
+            string resort = move(refreshQueue.front());
+            refreshQueue.pop_front();
+            auto it = cache.find(resort);
+            if (it == cache.end()) {
+                continue;
+            }
+            it->second.state = RefreshState::Refreshing;
+
+            lock.unlock();
+            string report;
+            bool ok = true;
+            try {
+                report = generateWeatherReport(resort);
+                storeSecondTier(resort, report, system_clock::now());
+            }
+            catch (const exception& e) {
+                cerr << "Background refresh for " << resort << " failed: " << e.what() << endl;
+                ok = false;
+            }
+            lock.lock();
+
+            // Look the entry up again; the map may have rehashed meanwhile.
+            it = cache.find(resort);
+            if (it == cache.end()) {
+                continue;
+            }
+            if (ok) {
+                it->second.generatedAt = system_clock::now();
+                it->second.report = move(report);
+                it->second.state = RefreshState::Fresh;
+            }
+            else {
+                it->second.state = RefreshState::Failed;
+            }
+        }
+    }
 };
 
 int main() {
@@ -46,5 +218,25 @@ int main() {
     string report = service.getWeatherReport("Blackstone");
     cout << "Weather Report: " << report << endl;
 
+    // Short TTL to show the refresh cycle: the second read lands in the
+    // refresh-ahead window, the third is past the TTL but inside the grace
+    // period, and neither waits for a regeneration.
+    WeatherReportService shortLived(milliseconds(200), milliseconds(50), milliseconds(500));
+    shortLived.getWeatherReport("Blackstone");
+    this_thread::sleep_for(milliseconds(170));
+    shortLived.getWeatherReport("Blackstone");
+    cout << "Refresh state: " << refreshStateName(shortLived.refreshState("Blackstone")) << endl;
+    this_thread::sleep_for(milliseconds(50));
+    cout << "Refresh state: " << refreshStateName(shortLived.refreshState("Blackstone")) << endl;
+    this_thread::sleep_for(milliseconds(300));
+    shortLived.getWeatherReport("Blackstone");
+
+    // Warm restart: the second service reads the report from the mapped file.
+    for (int run = 0; run < 2; ++run) {
+        WeatherReportService restarted(seconds(3600), seconds(300), seconds(600),
+                                       make_shared<mmap_cache_tier::L2Tier<string, string>>("weather_reports.l2", 1024));
+        restarted.getWeatherReport("Whistler");
+    }
+
     return 0;
 }